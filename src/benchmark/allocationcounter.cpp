@@ -0,0 +1,89 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+namespace {
+
+std::atomic<unsigned long long> s_Allocations(0);
+
+}
+
+
+#if defined(__GLIBC__)
+
+// Qt allocates its string and container data with malloc so that is what needs to be
+// counted. Defining malloc in the executable takes precedence over the one in libc for
+// all libraries, operator new ends up here as well
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+  ++s_Allocations;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+  ++s_Allocations;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+  ++s_Allocations;
+  return __libc_realloc(pointer, size);
+}
+
+}
+
+bool allocationCountIncludesMalloc()
+{
+  return true;
+}
+
+#else // __GLIBC__
+
+void *operator new(std::size_t size)
+{
+  ++s_Allocations;
+  void *result = std::malloc(size == 0 ? 1 : size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+void operator delete(void *pointer) throw()
+{
+  std::free(pointer);
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete[](void *pointer) throw()
+{
+  operator delete(pointer);
+}
+
+bool allocationCountIncludesMalloc()
+{
+  return false;
+}
+
+#endif // __GLIBC__
+
+
+unsigned long long allocationCount()
+{
+  return s_Allocations.load();
+}
@@ -0,0 +1,15 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+/**
+ * @return the number of heap allocations made by the process so far
+ */
+unsigned long long allocationCount();
+
+/**
+ * @return true if allocations made by Qt are included in the count. Otherwise only
+ *         allocations through operator new are counted
+ */
+bool allocationCountIncludesMalloc();
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,26 @@
+#ifndef UTILITY_H
+#define UTILITY_H
+
+// Stand-in for the utility.h of uibase so the parser can be built without the rest of MO.
+// Only provides what the parser sources use.
+
+#include <QByteArray>
+#include <QString>
+
+#include <exception>
+
+namespace MOBase {
+
+class MyException : public std::exception {
+public:
+  MyException(const QString &text)
+    : std::exception(), m_Message(text.toLocal8Bit()) {}
+  virtual const char *what() const throw()
+  { return m_Message.constData(); }
+private:
+  QByteArray m_Message;
+};
+
+}
+
+#endif // UTILITY_H
@@ -0,0 +1,275 @@
+#include "generator.h"
+
+#include <QString>
+#include <QTextCodec>
+#include <QXmlStreamWriter>
+
+
+namespace {
+
+const char *const GROUP_TYPES[] = {
+  "SelectAny",
+  "SelectExactlyOne",
+  "SelectAtMostOne",
+  "SelectAtLeastOne",
+  "SelectAll"
+};
+
+const char *const PLUGIN_TYPES[] = {
+  "Optional",
+  "Recommended",
+  "Required",
+  "NotUsable",
+  "CouldBeUsable"
+};
+
+
+class Generator
+{
+public:
+
+  Generator(const GeneratorOptions &options)
+    : m_Options(options), m_Writer(&m_Text), m_Elements(0)
+  {
+    m_Writer.setAutoFormatting(true);
+  }
+
+  GeneratedDocument moduleConfig()
+  {
+    start("config");
+    m_Writer.writeAttribute("xmlns:xsi", "http://www.w3.org/2001/XMLSchema-instance");
+    m_Writer.writeAttribute("xsi:noNamespaceSchemaLocation", "http://qconsulting.ca/fo3/ModConfig5.0.xsd");
+    text("moduleName", QString::fromUtf8("Synthetic Module \xc3\x9c\x62\x65r"));
+    empty("moduleImage", "path", "fomod/images/module.png");
+
+    start("moduleDependencies");
+    m_Writer.writeAttribute("operator", "And");
+    empty("gameDependency", "version", "1.0");
+    end();
+
+    start("requiredInstallFiles");
+    for (int i = 0; i < m_Options.filesPerPlugin; ++i) {
+      file(QString("required/file%1.esp").arg(i), 0);
+    }
+    end();
+
+    start("installSteps");
+    m_Writer.writeAttribute("order", "Explicit");
+    for (int step = 0; step < m_Options.steps; ++step) {
+      installStep(step);
+    }
+    end();
+
+    start("conditionalFileInstalls");
+    start("patterns");
+    for (int i = 0; i < m_Options.conditionalInstalls; ++i) {
+      start("pattern");
+      dependencies(m_Options.dependencyDepth, i);
+      start("files");
+      file(QString("conditional/%1/patch.esp").arg(i), i % 3);
+      end();
+      end();
+    }
+    end();
+    end();
+
+    end();
+    return finish();
+  }
+
+  GeneratedDocument info()
+  {
+    start("fomod");
+    text("Name", QString::fromUtf8("Synthetic Mod \xc3\xa9\x64ition"));
+    text("Author", "Generator");
+    text("Version", "1.2.3");
+    text("Id", "12345");
+    text("Website", "http://www.example.com/mods/12345");
+    end();
+    return finish();
+  }
+
+private:
+
+  void start(const QString &name)
+  {
+    m_Writer.writeStartElement(name);
+    ++m_Elements;
+  }
+
+  void end()
+  {
+    m_Writer.writeEndElement();
+  }
+
+  void text(const QString &name, const QString &content)
+  {
+    m_Writer.writeTextElement(name, content);
+    ++m_Elements;
+  }
+
+  void empty(const QString &name, const QString &attribute, const QString &value)
+  {
+    m_Writer.writeEmptyElement(name);
+    m_Writer.writeAttribute(attribute, value);
+    ++m_Elements;
+  }
+
+  void file(const QString &source, int priority)
+  {
+    m_Writer.writeEmptyElement("file");
+    m_Writer.writeAttribute("source", source);
+    m_Writer.writeAttribute("destination", source);
+    m_Writer.writeAttribute("priority", QString::number(priority));
+    ++m_Elements;
+  }
+
+  void dependencies(int depth, int seed)
+  {
+    start("dependencies");
+    m_Writer.writeAttribute("operator", (depth % 2) == 0 ? "Or" : "And");
+    m_Writer.writeEmptyElement("flagDependency");
+    m_Writer.writeAttribute("flag", QString("flag%1").arg(seed % 16));
+    m_Writer.writeAttribute("value", "On");
+    ++m_Elements;
+    m_Writer.writeEmptyElement("fileDependency");
+    m_Writer.writeAttribute("file", QString("Plugin%1.esp").arg(seed % 7));
+    m_Writer.writeAttribute("state", "Active");
+    ++m_Elements;
+    if (depth > 1) {
+      dependencies(depth - 1, seed + 1);
+    }
+    end();
+  }
+
+  void installStep(int step)
+  {
+    start("installStep");
+    m_Writer.writeAttribute("name", QString("Step %1").arg(step, 3, 10, QChar('0')));
+    if ((step % 2) == 1) {
+      start("visible");
+      m_Writer.writeAttribute("operator", "Or");
+      start("dependencies");
+      m_Writer.writeAttribute("operator", "And");
+      m_Writer.writeEmptyElement("flagDependency");
+      m_Writer.writeAttribute("flag", QString("flag%1").arg(step % 16));
+      m_Writer.writeAttribute("value", "On");
+      ++m_Elements;
+      end();
+      end();
+    }
+    start("optionalFileGroups");
+    m_Writer.writeAttribute("order", "Explicit");
+    for (int group = 0; group < m_Options.groupsPerStep; ++group) {
+      start("group");
+      m_Writer.writeAttribute("name", QString("Group %1-%2").arg(step).arg(group));
+      m_Writer.writeAttribute("type", GROUP_TYPES[(step + group) % 5]);
+      start("plugins");
+      m_Writer.writeAttribute("order", "Explicit");
+      for (int plugin = 0; plugin < m_Options.pluginsPerGroup; ++plugin) {
+        writePlugin(step, group, plugin);
+      }
+      end();
+      end();
+    }
+    end();
+    end();
+  }
+
+  void writePlugin(int step, int group, int plugin)
+  {
+    QString id = QString("%1-%2-%3").arg(step).arg(group).arg(plugin);
+    start("plugin");
+    m_Writer.writeAttribute("name", QString::fromUtf8("Option %1 R\xc3\xbcstung").arg(id));
+    text("description", QString::fromUtf8("Installs the option %1. "
+                                          "Enth\xc3\xa4lt Texturen und Meshes f\xc3\xbcr alle R\xc3\xbcstungen.").arg(id));
+    empty("image", "path", QString("fomod\\images\\%1.png").arg(id));
+    start("conditionFlags");
+    start("flag");
+    m_Writer.writeAttribute("name", QString("flag%1").arg((step + plugin) % 16));
+    m_Writer.writeCharacters("On");
+    end();
+    end();
+    start("files");
+    for (int i = 0; i < m_Options.filesPerPlugin; ++i) {
+      file(QString("%1\\Data\\Textures\\file%2.dds").arg(id).arg(i), i % 4);
+    }
+    m_Writer.writeEmptyElement("folder");
+    m_Writer.writeAttribute("source", QString("%1\\Meshes").arg(id));
+    m_Writer.writeAttribute("destination", "Meshes");
+    ++m_Elements;
+    end();
+    start("typeDescriptor");
+    if ((plugin % 3) == 0) {
+      start("dependencyType");
+      empty("defaultType", "name", PLUGIN_TYPES[plugin % 5]);
+      start("patterns");
+      start("pattern");
+      dependencies(m_Options.dependencyDepth, plugin);
+      empty("type", "name", PLUGIN_TYPES[(plugin + 1) % 5]);
+      end();
+      end();
+      end();
+    } else {
+      empty("type", "name", PLUGIN_TYPES[plugin % 5]);
+    }
+    end();
+    end();
+  }
+
+  GeneratedDocument finish()
+  {
+    GeneratedDocument result;
+    result.elements = m_Elements;
+    switch (m_Options.encoding) {
+      case GeneratorOptions::ENCODING_UTF8: {
+        result.data = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + m_Text.toUtf8();
+      } break;
+      case GeneratorOptions::ENCODING_UTF16: {
+        QTextCodec *codec = QTextCodec::codecForName("UTF-16LE");
+        result.data = QByteArray("\xff\xfe", 2)
+                      + codec->fromUnicode("<?xml version=\"1.0\" encoding=\"UTF-16\"?>\n" + m_Text);
+      } break;
+      case GeneratorOptions::ENCODING_UTF8_AS_UTF16: {
+        result.data = "<?xml version=\"1.0\" encoding=\"UTF-16\"?>\n" + m_Text.toUtf8();
+      } break;
+      case GeneratorOptions::ENCODING_LATIN1_AS_UTF8: {
+        result.data = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + m_Text.toLatin1();
+      } break;
+    }
+    return result;
+  }
+
+private:
+
+  GeneratorOptions m_Options;
+  QString m_Text;
+  QXmlStreamWriter m_Writer;
+  int m_Elements;
+
+};
+
+}
+
+
+GeneratorOptions::GeneratorOptions()
+  : steps(10), groupsPerStep(4), pluginsPerGroup(8), filesPerPlugin(6), dependencyDepth(3)
+  , conditionalInstalls(50), encoding(ENCODING_UTF8)
+{
+}
+
+
+GeneratedDocument generateModuleConfig(const GeneratorOptions &options)
+{
+  Generator generator(options);
+  return generator.moduleConfig();
+}
+
+
+GeneratedDocument generateInfo(GeneratorOptions::Encoding encoding)
+{
+  GeneratorOptions options;
+  options.encoding = encoding;
+  Generator generator(options);
+  return generator.info();
+}
@@ -0,0 +1,49 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <QByteArray>
+
+/**
+ * @brief shape of a synthetic fomod
+ */
+struct GeneratorOptions {
+
+  enum Encoding {
+    ENCODING_UTF8,             // utf-8, declared as such
+    ENCODING_UTF16,            // utf-16 with byte order mark, declared as such
+    ENCODING_UTF8_AS_UTF16,    // utf-8 content but the header claims utf-16
+    ENCODING_LATIN1_AS_UTF8    // latin-1 content but the header claims utf-8
+  };
+
+  GeneratorOptions();
+
+  int steps;
+  int groupsPerStep;
+  int pluginsPerGroup;
+  int filesPerPlugin;
+  // nesting depth of the dependencies in visibility conditions and dependency patterns
+  int dependencyDepth;
+  int conditionalInstalls;
+  Encoding encoding;
+};
+
+/**
+ * @brief a generated xml document
+ */
+struct GeneratedDocument {
+  QByteArray data;
+  // number of elements in the document
+  int elements;
+};
+
+/**
+ * @brief generate a ModuleConfig.xml
+ */
+GeneratedDocument generateModuleConfig(const GeneratorOptions &options);
+
+/**
+ * @brief generate an info.xml
+ */
+GeneratedDocument generateInfo(GeneratorOptions::Encoding encoding);
+
+#endif // GENERATOR_H
@@ -0,0 +1,269 @@
+/*
+Benchmark for the fomod parser. Generates synthetic ModuleConfig.xml and info.xml files and
+reports parse throughput and allocations per element. Runs without Mod Organizer.
+*/
+
+#include "allocationcounter.h"
+#include "generator.h"
+
+#include "encodingsniffer.h"
+#include "fomodparser.h"
+#include "xmlreader.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+bool s_Verbose = false;
+
+void messageHandler(QtMsgType type, const QMessageLogContext&, const QString &message)
+{
+  if (s_Verbose || (type == QtCriticalMsg) || (type == QtFatalMsg)) {
+    fprintf(stderr, "%s\n", qPrintable(message));
+  }
+}
+
+
+struct Scenario {
+  QString name;
+  GeneratorOptions options;
+};
+
+
+struct Measurement {
+  qint64 nanoseconds;
+  unsigned long long allocations;
+  bool success;
+};
+
+
+// runs the function repeatedly, reporting the fastest run
+template <typename Func>
+Measurement measure(int iterations, Func func)
+{
+  Measurement result = { std::numeric_limits<qint64>::max(), 0, true };
+  for (int i = 0; i < iterations; ++i) {
+    unsigned long long allocationsBefore = allocationCount();
+    QElapsedTimer timer;
+    timer.start();
+    bool success = func();
+    qint64 elapsed = timer.nsecsElapsed();
+    unsigned long long allocations = allocationCount() - allocationsBefore;
+
+    result.success = result.success && success;
+    if (elapsed < result.nanoseconds) {
+      result.nanoseconds = elapsed;
+      result.allocations = allocations;
+    }
+  }
+  return result;
+}
+
+
+void report(const QString &scenario, const char *stage, const Measurement &measurement,
+            int bytes, int elements)
+{
+  double seconds = std::max<double>(measurement.nanoseconds, 1.0) / 1e9;
+  printf("%-22s %-8s %10.2f MB/s %14.0f elements/s %10.2f allocs/element%s\n",
+         qPrintable(scenario), stage,
+         (bytes / (1024.0 * 1024.0)) / seconds,
+         elements / seconds,
+         static_cast<double>(measurement.allocations) / elements,
+         measurement.success ? "" : "  FAILED");
+}
+
+
+// walks over all tokens the same way the parser does, without building a document
+bool tokenize(const QByteArray &data, int expectedElements)
+{
+  EncodingSniffer sniffer(data.constData(), static_cast<std::size_t>(data.size()));
+  std::unique_ptr<XmlReader> reader(sniffer.declarationMatches() ? new XmlReader(data)
+                                                                 : new XmlReader(sniffer.decode()));
+  int elements = 0;
+  while (!reader->atEnd()) {
+    if (reader->readNext() == XmlReader::StartElement) {
+      ++elements;
+    }
+  }
+  return !reader->hasError() && (elements == expectedElements);
+}
+
+
+bool parse(const QString &fileName, const GeneratorOptions &options)
+{
+  try {
+    std::unique_ptr<FomodDocument> document = FomodParser::readModuleConfig(fileName);
+    if ((document.get() == nullptr)
+        || (document->m_Steps.size() != static_cast<size_t>(options.steps))
+        || (document->m_ConditionalInstalls.size() != static_cast<size_t>(options.conditionalInstalls))) {
+      return false;
+    }
+    for (const InstallStep &step : document->m_Steps) {
+      if (step.m_Groups.size() != static_cast<size_t>(options.groupsPerStep)) {
+        return false;
+      }
+      for (const Group &group : step.m_Groups) {
+        if (group.m_Plugins.size() != static_cast<size_t>(options.pluginsPerGroup)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  } catch (const std::exception &e) {
+    qCritical("parsing %s failed: %s", qPrintable(fileName), e.what());
+    return false;
+  }
+}
+
+
+bool parseInfo(const QByteArray &data)
+{
+  try {
+    EncodingSniffer sniffer(data.constData(), static_cast<std::size_t>(data.size()));
+    std::unique_ptr<XmlReader> reader(sniffer.declarationMatches() ? new XmlReader(data)
+                                                                   : new XmlReader(sniffer.decode()));
+    FomodInfo info;
+    FomodParser::parseInfo(*reader, info);
+    return info.m_ModID == 12345;
+  } catch (const std::exception &e) {
+    qCritical("parsing info.xml failed: %s", e.what());
+    return false;
+  }
+}
+
+
+const char *encodingName(GeneratorOptions::Encoding encoding)
+{
+  switch (encoding) {
+    case GeneratorOptions::ENCODING_UTF16:          return "utf-16";
+    case GeneratorOptions::ENCODING_UTF8_AS_UTF16:  return "utf-8 as utf-16";
+    case GeneratorOptions::ENCODING_LATIN1_AS_UTF8: return "latin-1 as utf-8";
+    default:                                        return "utf-8";
+  }
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  qInstallMessageHandler(messageHandler);
+
+  QCommandLineParser commandLine;
+  commandLine.setApplicationDescription("Measures the performance of the fomod parser on synthetic input");
+  commandLine.addHelpOption();
+  QCommandLineOption quickOption("quick", "Small documents and few iterations, for use as a test");
+  QCommandLineOption verboseOption("verbose", "Show messages from the parser");
+  QCommandLineOption stepsOption("steps", "Number of install steps", "count");
+  QCommandLineOption groupsOption("groups", "Number of groups per step", "count");
+  QCommandLineOption pluginsOption("plugins", "Number of plugins per group", "count");
+  QCommandLineOption filesOption("files", "Number of files per plugin", "count");
+  QCommandLineOption depthOption("depth", "Nesting depth of dependencies", "count");
+  QCommandLineOption iterationsOption("iterations", "Number of runs per measurement", "count");
+  QCommandLineOption keepOption("keep", "Write the generated files to this directory", "directory");
+  for (const QCommandLineOption &option : { quickOption, verboseOption, stepsOption, groupsOption, pluginsOption,
+                                            filesOption, depthOption, iterationsOption, keepOption }) {
+    commandLine.addOption(option);
+  }
+  commandLine.process(app);
+
+  s_Verbose = commandLine.isSet(verboseOption);
+
+  GeneratorOptions base;
+  int iterations = 10;
+  if (commandLine.isSet(quickOption)) {
+    base.steps = 3;
+    base.groupsPerStep = 2;
+    base.pluginsPerGroup = 4;
+    base.filesPerPlugin = 2;
+    base.conditionalInstalls = 5;
+    iterations = 2;
+  } else {
+    base.steps = 30;
+    base.groupsPerStep = 6;
+    base.pluginsPerGroup = 20;
+    base.filesPerPlugin = 20;
+    base.conditionalInstalls = 200;
+  }
+  auto intOption = [&commandLine] (const QCommandLineOption &option, int defaultValue) {
+    return commandLine.isSet(option) ? commandLine.value(option).toInt() : defaultValue;
+  };
+  base.steps = intOption(stepsOption, base.steps);
+  base.groupsPerStep = intOption(groupsOption, base.groupsPerStep);
+  base.pluginsPerGroup = intOption(pluginsOption, base.pluginsPerGroup);
+  base.filesPerPlugin = intOption(filesOption, base.filesPerPlugin);
+  base.dependencyDepth = intOption(depthOption, base.dependencyDepth);
+  iterations = std::max(1, intOption(iterationsOption, iterations));
+
+  std::vector<Scenario> scenarios;
+  for (GeneratorOptions::Encoding encoding : { GeneratorOptions::ENCODING_UTF8,
+                                               GeneratorOptions::ENCODING_UTF16,
+                                               GeneratorOptions::ENCODING_UTF8_AS_UTF16,
+                                               GeneratorOptions::ENCODING_LATIN1_AS_UTF8 }) {
+    Scenario scenario = { encodingName(encoding), base };
+    scenario.options.encoding = encoding;
+    scenarios.push_back(scenario);
+  }
+  Scenario deep = { "deep dependencies", base };
+  deep.options.dependencyDepth = base.dependencyDepth * 4;
+  scenarios.push_back(deep);
+
+  QTemporaryDir temporaryDirectory;
+  QString directory = commandLine.isSet(keepOption) ? commandLine.value(keepOption)
+                                                    : temporaryDirectory.path();
+
+  if (!allocationCountIncludesMalloc()) {
+    printf("note: allocations made by Qt are not included on this platform\n");
+  }
+
+  bool success = true;
+  int index = 0;
+  for (const Scenario &scenario : scenarios) {
+    GeneratedDocument document = generateModuleConfig(scenario.options);
+    QString fileName = QString("%1/ModuleConfig%2.xml").arg(directory).arg(index++);
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || (file.write(document.data) != document.data.size())) {
+      fprintf(stderr, "failed to write %s\n", qPrintable(fileName));
+      return 1;
+    }
+    file.close();
+
+    Measurement tokens = measure(iterations, [&] () { return tokenize(document.data, document.elements); });
+    report(scenario.name, "reader", tokens, document.data.size(), document.elements);
+    Measurement full = measure(iterations, [&] () { return parse(fileName, scenario.options); });
+    report(scenario.name, "parse", full, document.data.size(), document.elements);
+    success = success && tokens.success && full.success;
+  }
+
+  for (GeneratorOptions::Encoding encoding : { GeneratorOptions::ENCODING_UTF8,
+                                               GeneratorOptions::ENCODING_LATIN1_AS_UTF8 }) {
+    GeneratedDocument info = generateInfo(encoding);
+    // info.xml is tiny, repeat it so the timer has something to measure
+    const int repeats = 100;
+    Measurement measurement = measure(iterations, [&] () {
+      bool result = true;
+      for (int i = 0; i < repeats; ++i) {
+        result = parseInfo(info.data) && result;
+      }
+      return result;
+    });
+    report(QString("info.xml %1").arg(encodingName(encoding)), "parse", measurement,
+           info.data.size() * repeats, info.elements * repeats);
+    success = success && measurement.success;
+  }
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+#include "cachetest.h"
+
+#include "fomodcache.h"
+#include "fomodparser.h"
+#include "xmlreader.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+
+namespace {
+
+// layout of the entry header: magic, version, key, payload size, checksum
+const int VERSION_OFFSET = 4;
+const int KEY_OFFSET = 8;
+const int SIZE_OFFSET = 28;
+const int CHECKSUM_OFFSET = 32;
+const int HEADER_SIZE = 48;
+
+const char *const MODULE_CONFIG =
+  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+  "<config>\n"
+  "  <moduleName>Cached</moduleName>\n"
+  "  <moduleDependencies>\n"
+  "    <foseDependency version=\"2.0.8\"/>\n"
+  "    <gameDependency version=\"1.9.32\"/>\n"
+  "  </moduleDependencies>\n"
+  "  <requiredInstallFiles>\n"
+  "    <folder source=\"Core\" destination=\"\"/>\n"
+  "  </requiredInstallFiles>\n"
+  "  <installSteps>\n"
+  "    <installStep name=\"Main\">\n"
+  "      <optionalFileGroups>\n"
+  "        <group name=\"Options\" type=\"SelectAny\">\n"
+  "          <plugins>\n"
+  "            <plugin name=\"Option\">\n"
+  "              <description>Description</description>\n"
+  "              <conditionFlags><flag name=\"option\">on</flag></conditionFlags>\n"
+  "              <files><file source=\"Option\\a.esp\" destination=\"a.esp\" priority=\"3\"/></files>\n"
+  "              <typeDescriptor>\n"
+  "                <dependencyType>\n"
+  "                  <defaultType name=\"Optional\"/>\n"
+  "                  <patterns>\n"
+  "                    <pattern>\n"
+  "                      <dependencies operator=\"Or\">\n"
+  "                        <flagDependency flag=\"option\" value=\"off\"/>\n"
+  "                        <dependencies><fileDependency file=\"b.esp\" state=\"Active\"/></dependencies>\n"
+  "                      </dependencies>\n"
+  "                      <type name=\"NotUsable\"/>\n"
+  "                    </pattern>\n"
+  "                  </patterns>\n"
+  "                </dependencyType>\n"
+  "              </typeDescriptor>\n"
+  "            </plugin>\n"
+  "          </plugins>\n"
+  "        </group>\n"
+  "      </optionalFileGroups>\n"
+  "    </installStep>\n"
+  "  </installSteps>\n"
+  "  <conditionalFileInstalls>\n"
+  "    <patterns>\n"
+  "      <pattern>\n"
+  "        <dependencies><flagDependency flag=\"option\" value=\"on\"/></dependencies>\n"
+  "        <files><file source=\"Option\\a.esp\" destination=\"a.esp\" priority=\"3\"/></files>\n"
+  "      </pattern>\n"
+  "    </patterns>\n"
+  "  </conditionalFileInstalls>\n"
+  "</config>\n";
+
+std::unique_ptr<FomodDocument> parse(const QByteArray &data)
+{
+  std::unique_ptr<FomodDocument> document(new FomodDocument);
+  XmlReader reader(data);
+  FomodParser parser(*document);
+  parser.parseModuleConfig(reader);
+  return document;
+}
+
+QByteArray makeKey(const char *name)
+{
+  return QCryptographicHash::hash(name, QCryptographicHash::Sha1);
+}
+
+// the single entry in a cache directory
+QString entryName(const QTemporaryDir &directory)
+{
+  QStringList entries = QDir(directory.path()).entryList(QStringList("*.bin"), QDir::Files);
+  return entries.size() == 1 ? directory.path() + "/" + entries.front() : QString();
+}
+
+QByteArray readFile(const QString &fileName)
+{
+  QFile file(fileName);
+  return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+bool writeFile(const QString &fileName, const QByteArray &data)
+{
+  QFile file(fileName);
+  return file.open(QIODevice::WriteOnly) && (file.write(data) == data.size());
+}
+
+int entryCount(const QTemporaryDir &directory)
+{
+  return QDir(directory.path()).entryList(QStringList("*.bin"), QDir::Files).size();
+}
+
+}
+
+
+void CacheTest::roundTrip()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path());
+  std::unique_ptr<FomodDocument> original = parse(MODULE_CONFIG);
+  QByteArray key = FomodCache::key(MODULE_CONFIG);
+  QVERIFY(cache.store(key, *original));
+
+  std::unique_ptr<FomodDocument> loaded = cache.load(key);
+  QVERIFY(loaded.get() != nullptr);
+
+  QCOMPARE(loaded->strings().size(), original->strings().size());
+  for (int i = 0; i < original->strings().size(); ++i) {
+    QCOMPARE(loaded->string(i), original->string(i));
+  }
+
+  QCOMPARE(loaded->conditions().size(), original->conditions().size());
+  for (size_t i = 0; i < original->conditions().size(); ++i) {
+    const Condition &expected = original->condition(static_cast<int>(i));
+    const Condition &actual = loaded->condition(static_cast<int>(i));
+    QCOMPARE(actual.m_Type, expected.m_Type);
+    QCOMPARE(actual.m_Name, expected.m_Name);
+    QCOMPARE(actual.m_Value, expected.m_Value);
+    QCOMPARE(actual.m_Version, expected.m_Version);
+    QCOMPARE(actual.m_Sub.m_First, expected.m_Sub.m_First);
+    QCOMPARE(actual.m_Sub.m_Count, expected.m_Sub.m_Count);
+  }
+
+  QCOMPARE(loaded->m_ModuleName, QString("Cached"));
+  QCOMPARE(loaded->m_ModuleDependencies.m_Count, original->m_ModuleDependencies.m_Count);
+  QCOMPARE(loaded->m_RequiredFiles.size(), size_t(1));
+  QVERIFY(loaded->m_RequiredFiles[0]->m_IsFolder);
+
+  const Plugin &plugin = loaded->m_Steps.at(0).m_Groups.at(0).m_Plugins.at(0);
+  QCOMPARE(plugin.m_Name, QString("Option"));
+  QCOMPARE(plugin.m_Description, QString("Description"));
+  QCOMPARE(plugin.m_ConditionFlags.size(), size_t(1));
+  QCOMPARE(plugin.m_PluginTypeInfo.m_DependencyPatterns.size(), size_t(1));
+  QCOMPARE(plugin.m_PluginTypeInfo.m_DependencyPatterns[0].type, TYPE_NOTUSABLE);
+  const FileDescriptor *file = plugin.m_Files.at(0);
+  QCOMPARE(file->m_Priority, 3);
+  QCOMPARE(loaded->string(file->m_SourcePath.m_Directory), QString("Option"));
+  QCOMPARE(loaded->string(file->m_SourcePath.m_NameKey), QString("a.esp"));
+
+  //Descriptors are stored once and referred to by index from the lists
+  QCOMPARE(loaded->fileDescriptors().size(), original->fileDescriptors().size());
+  QCOMPARE(loaded->m_ConditionalInstalls.size(), size_t(1));
+  QCOMPARE(loaded->m_ConditionalInstalls[0].m_Files.at(0)->m_FileSystemItemSequence,
+           original->m_ConditionalInstalls[0].m_Files.at(0)->m_FileSystemItemSequence);
+}
+
+void CacheTest::missesUnknownKey()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path());
+  QVERIFY(cache.load(makeKey("unknown")).get() == nullptr);
+}
+
+void CacheTest::rejectsDamagedHeader_data()
+{
+  QTest::addColumn<int>("offset");
+
+  QTest::newRow("magic") << 0;
+  QTest::newRow("version") << VERSION_OFFSET + 3;
+  QTest::newRow("key") << KEY_OFFSET;
+  QTest::newRow("size") << SIZE_OFFSET + 3;
+  QTest::newRow("checksum") << CHECKSUM_OFFSET;
+  QTest::newRow("payload") << HEADER_SIZE + 1;
+}
+
+void CacheTest::rejectsDamagedHeader()
+{
+  QFETCH(int, offset);
+
+  QTemporaryDir directory;
+  FomodCache cache(directory.path());
+  QByteArray key = makeKey("damaged");
+  QVERIFY(cache.store(key, *parse(MODULE_CONFIG)));
+  QVERIFY(cache.load(key).get() != nullptr);
+
+  QString fileName = entryName(directory);
+  QByteArray data = readFile(fileName);
+  QVERIFY(data.size() > offset);
+  data[offset] = static_cast<char>(data.at(offset) ^ 0xFF);
+  QVERIFY(writeFile(fileName, data));
+
+  QVERIFY(cache.load(key).get() == nullptr);
+}
+
+void CacheTest::rejectsTruncatedEntry()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path());
+  QByteArray key = makeKey("truncated");
+  QVERIFY(cache.store(key, *parse(MODULE_CONFIG)));
+
+  QString fileName = entryName(directory);
+  QByteArray data = readFile(fileName);
+  QVERIFY(writeFile(fileName, data.left(data.size() - 1)));
+  QVERIFY(cache.load(key).get() == nullptr);
+
+  QVERIFY(writeFile(fileName, data.left(HEADER_SIZE - 1)));
+  QVERIFY(cache.load(key).get() == nullptr);
+}
+
+void CacheTest::rejectsInvalidPayload()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path());
+  QByteArray key = makeKey("invalid");
+  QVERIFY(cache.store(key, *parse(MODULE_CONFIG)));
+
+  //A payload with a valid checksum that doesn't describe a document: the string count
+  //claims more strings than there is data
+  QString fileName = entryName(directory);
+  QByteArray data = readFile(fileName).left(HEADER_SIZE);
+  QByteArray payload("\x00\x10\x00\x00", 4);
+  QByteArray size("\x00\x00\x00\x04", 4);
+  data.replace(SIZE_OFFSET, size.size(), size);
+  data.replace(CHECKSUM_OFFSET, 16, QCryptographicHash::hash(payload, QCryptographicHash::Md5));
+  QVERIFY(writeFile(fileName, data + payload));
+
+  QVERIFY(cache.load(key).get() == nullptr);
+}
+
+void CacheTest::prunesByCount()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path(), 2);
+  std::unique_ptr<FomodDocument> document = parse(MODULE_CONFIG);
+  for (const char *name : { "first", "second", "third" }) {
+    QVERIFY(cache.store(makeKey(name), *document));
+  }
+
+  QCOMPARE(entryCount(directory), 2);
+  QVERIFY(cache.load(makeKey("third")).get() != nullptr);
+}
+
+void CacheTest::prunesBySize()
+{
+  QTemporaryDir directory;
+  FomodCache cache(directory.path(), FomodCache::DEFAULT_MAX_ENTRIES, 1);
+  std::unique_ptr<FomodDocument> document = parse(MODULE_CONFIG);
+  QVERIFY(cache.store(makeKey("first"), *document));
+  QVERIFY(cache.store(makeKey("second"), *document));
+
+  //The entry just stored is kept even though it exceeds the limit on its own
+  QCOMPARE(entryCount(directory), 1);
+  QVERIFY(cache.load(makeKey("second")).get() != nullptr);
+  QVERIFY(cache.load(makeKey("first")).get() == nullptr);
+}
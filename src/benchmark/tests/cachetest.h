@@ -0,0 +1,26 @@
+#ifndef CACHETEST_H
+#define CACHETEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests storing documents in the FomodCache and rejecting damaged entries
+ */
+class CacheTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void roundTrip();
+  void missesUnknownKey();
+  void rejectsDamagedHeader_data();
+  void rejectsDamagedHeader();
+  void rejectsTruncatedEntry();
+  void rejectsInvalidPayload();
+  void prunesByCount();
+  void prunesBySize();
+
+};
+
+#endif // CACHETEST_H
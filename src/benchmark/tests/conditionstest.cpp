@@ -0,0 +1,245 @@
+#include "conditionstest.h"
+
+#include "compiledconditions.h"
+#include "fomodparser.h"
+#include "xmlreader.h"
+
+#include <QSet>
+#include <QTest>
+
+#include <memory>
+
+
+namespace {
+
+std::unique_ptr<FomodDocument> parse(const QByteArray &content)
+{
+  std::unique_ptr<FomodDocument> document(new FomodDocument);
+  XmlReader reader("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                   "<config>\n"
+                   "  <moduleName>Test Mod</moduleName>\n"
+                   + content
+                   + "</config>\n");
+  FomodParser parser(*document);
+  parser.parseModuleConfig(reader);
+  return document;
+}
+
+// conditions without flag tests never reach the tester
+struct NoFlags {
+  bool testFlag(int, int, int) const { return false; }
+};
+
+// the flags in the set have the tested value, all others don't
+struct FlagSet {
+  explicit FlagSet(const QSet<int> &flags) : flags(flags), tests(0) {}
+  bool testFlag(int, int flag, int) const { ++tests; return flags.contains(flag); }
+  QSet<int> flags;
+  mutable int tests;
+};
+
+}
+
+
+void ConditionsTest::packsVersions()
+{
+  QCOMPARE(Condition::packVersion("1.2.3"), Condition::packVersion("1.2.3.0"));
+  QCOMPARE(Condition::packVersion(" 1.2"), Condition::packVersion("1.2"));
+  QCOMPARE(Condition::packVersion("1.2beta"), Condition::packVersion("1.2"));
+  QVERIFY(Condition::packVersion("1.9.32") < Condition::packVersion("1.10"));
+  QCOMPARE(Condition::packVersion(Condition::FOMM_VERSION_STRING), Condition::FOMM_VERSION);
+
+  QCOMPARE(Condition::packVersion("1.65534"), (Q_UINT64_C(1) << 48) | (Q_UINT64_C(65534) << 32));
+  QCOMPARE(Condition::packVersion("1.65535"), Condition::UNPACKED_VERSION);
+  QCOMPARE(Condition::packVersion("1.9.32.70000"), Condition::UNPACKED_VERSION);
+  QCOMPARE(Condition::packVersion("20231105"), Condition::UNPACKED_VERSION);
+}
+
+void ConditionsTest::comparesUnpackedVersions_data()
+{
+  QTest::addColumn<QString>("lhs");
+  QTest::addColumn<QString>("rhs");
+  QTest::addColumn<bool>("lessEqual");
+
+  QTest::newRow("large last part") << "1.9.32.8" << "1.9.32.70000" << true;
+  QTest::newRow("large last part reversed") << "1.9.32.70000" << "1.9.32.8" << false;
+  QTest::newRow("differ above 65535") << "1.9.32.70000" << "1.9.32.70001" << true;
+  QTest::newRow("date") << "20231105" << "20231106" << true;
+  QTest::newRow("date reversed") << "20231106" << "20231105" << false;
+  QTest::newRow("equal") << "20231105" << "20231105.0" << true;
+  QTest::newRow("earlier part decides") << "2.0" << "1.70000" << false;
+}
+
+void ConditionsTest::comparesUnpackedVersions()
+{
+  QFETCH(QString, lhs);
+  QFETCH(QString, rhs);
+  QFETCH(bool, lessEqual);
+
+  QCOMPARE(Condition::versionLessEqual(lhs, rhs), lessEqual);
+}
+
+void ConditionsTest::foldsUnpackedVersions_data()
+{
+  QTest::addColumn<QString>("required");
+  QTest::addColumn<QString>("game");
+  QTest::addColumn<bool>("result");
+
+  QTest::newRow("required not packed") << "1.9.32.70000" << "1.9.32.8" << false;
+  QTest::newRow("game not packed") << "1.9.32.8" << "1.9.32.70000" << true;
+  QTest::newRow("neither packed") << "20231106" << "20231105" << false;
+  QTest::newRow("both packed") << "1.9.32" << "1.10" << true;
+}
+
+void ConditionsTest::foldsUnpackedVersions()
+{
+  QFETCH(QString, required);
+  QFETCH(QString, game);
+  QFETCH(bool, result);
+
+  std::unique_ptr<FomodDocument> document =
+      parse("  <moduleDependencies>\n"
+            "    <gameDependency version=\"" + required.toUtf8() + "\"/>\n"
+            "  </moduleDependencies>\n");
+  CompiledConditions::Session session;
+  session.gameVersionString = game;
+  session.gameVersion = Condition::packVersion(game);
+  CompiledConditions conditions;
+  conditions.compile(*document, session);
+
+  QCOMPARE(conditions.evaluate(document->m_ModuleDependencies.m_Index, 0, NoFlags()), result);
+}
+
+void ConditionsTest::foldsFileDependencies()
+{
+  std::unique_ptr<FomodDocument> document = parse(
+    "  <moduleDependencies operator=\"And\">\n"
+    "    <fileDependency file=\"Base.esm\" state=\"Active\"/>\n"
+    "    <flagDependency flag=\"a\" value=\"on\"/>\n"
+    "  </moduleDependencies>\n");
+  CompiledConditions::Session session;
+  session.fileStates.insert("Base.esm", "Active");
+  CompiledConditions conditions;
+  conditions.compile(*document, session);
+
+  //Only the flag test remains
+  int index = document->m_ModuleDependencies.m_Index;
+  QCOMPARE(conditions.flags(index), std::vector<int>{ conditions.flagId("a") });
+  QCOMPARE(conditions.eliminatedNodes(), 2);
+  QVERIFY(conditions.evaluate(index, 0, FlagSet(QSet<int>() << conditions.flagId("a"))));
+  QVERIFY(!conditions.evaluate(index, 0, FlagSet(QSet<int>())));
+
+  //With the file missing the whole condition is false
+  session.fileStates.insert("Base.esm", "Missing");
+  conditions.compile(*document, session);
+  index = document->m_ModuleDependencies.m_Index;
+  QVERIFY(conditions.flags(index).empty());
+  QVERIFY(!conditions.evaluate(index, 0, NoFlags()));
+}
+
+void ConditionsTest::foldsDecidedGroups()
+{
+  std::unique_ptr<FomodDocument> document = parse(
+    "  <moduleDependencies operator=\"Or\">\n"
+    "    <flagDependency flag=\"a\" value=\"on\"/>\n"
+    "    <gameDependency version=\"1.0\"/>\n"
+    "    <flagDependency flag=\"b\" value=\"on\"/>\n"
+    "  </moduleDependencies>\n");
+  CompiledConditions::Session session;
+  session.gameVersionString = "1.5";
+  session.gameVersion = Condition::packVersion(session.gameVersionString);
+  CompiledConditions conditions;
+  conditions.compile(*document, session);
+
+  //The version dependency holds so the flags are never tested
+  FlagSet tester((QSet<int>()));
+  QVERIFY(conditions.evaluate(document->m_ModuleDependencies.m_Index, 0, tester));
+  QCOMPARE(tester.tests, 0);
+  QCOMPARE(conditions.size(), size_t(1));
+}
+
+void ConditionsTest::flattensAndReorders()
+{
+  std::unique_ptr<FomodDocument> document = parse(
+    "  <moduleDependencies operator=\"Or\">\n"
+    "    <dependencies operator=\"And\">\n"
+    "      <flagDependency flag=\"a\" value=\"on\"/>\n"
+    "      <flagDependency flag=\"b\" value=\"on\"/>\n"
+    "    </dependencies>\n"
+    "    <dependencies operator=\"Or\">\n"
+    "      <flagDependency flag=\"c\" value=\"on\"/>\n"
+    "    </dependencies>\n"
+    "  </moduleDependencies>\n");
+  CompiledConditions conditions;
+  conditions.compile(*document, CompiledConditions::Session());
+
+  //The single operand group is replaced by its flag test, which is cheaper than the
+  //"and" group and moves in front of it
+  QCOMPARE(conditions.eliminatedNodes(), 1);
+  QCOMPARE(conditions.reorderedGroups(), 1);
+
+  int index = document->m_ModuleDependencies.m_Index;
+  FlagSet tester(QSet<int>() << conditions.flagId("c"));
+  QVERIFY(conditions.evaluate(index, 0, tester));
+  QCOMPARE(tester.tests, 1);
+  QCOMPARE(conditions.statistics().shortCircuitedTests, 2);
+
+  FlagSet both(QSet<int>() << conditions.flagId("a") << conditions.flagId("b"));
+  QVERIFY(conditions.evaluate(index, 0, both));
+  QCOMPARE(both.tests, 3);
+}
+
+void ConditionsTest::countsDeadConditions()
+{
+  std::unique_ptr<FomodDocument> document = parse(
+    "  <installSteps>\n"
+    "    <installStep name=\"Main\">\n"
+    "      <optionalFileGroups>\n"
+    "        <group name=\"Options\" type=\"SelectAny\">\n"
+    "          <plugins>\n"
+    "            <plugin name=\"Option\">\n"
+    "              <description/>\n"
+    "              <typeDescriptor>\n"
+    "                <dependencyType>\n"
+    "                  <defaultType name=\"Optional\"/>\n"
+    "                  <patterns>\n"
+    "                    <pattern>\n"
+    "                      <dependencies><fileDependency file=\"a.esp\" state=\"Active\"/></dependencies>\n"
+    "                      <type name=\"Recommended\"/>\n"
+    "                    </pattern>\n"
+    "                    <pattern>\n"
+    "                      <dependencies><flagDependency flag=\"a\" value=\"on\"/></dependencies>\n"
+    "                      <type name=\"Required\"/>\n"
+    "                    </pattern>\n"
+    "                  </patterns>\n"
+    "                </dependencyType>\n"
+    "              </typeDescriptor>\n"
+    "            </plugin>\n"
+    "          </plugins>\n"
+    "        </group>\n"
+    "      </optionalFileGroups>\n"
+    "    </installStep>\n"
+    "  </installSteps>\n"
+    "  <conditionalFileInstalls>\n"
+    "    <patterns>\n"
+    "      <pattern>\n"
+    "        <dependencies><fileDependency file=\"b.esp\" state=\"Active\"/></dependencies>\n"
+    "        <files><file source=\"b.esp\"/></files>\n"
+    "      </pattern>\n"
+    "    </patterns>\n"
+    "  </conditionalFileInstalls>\n");
+  CompiledConditions::Session session;
+  session.fileStates.insert("a.esp", "Active");
+  session.fileStates.insert("b.esp", "Missing");
+  CompiledConditions conditions;
+  conditions.compile(*document, session);
+
+  //The first pattern always matches so the second one is unreachable
+  QCOMPARE(conditions.deadPatterns(), 1);
+  QCOMPARE(conditions.deadInstalls(), 1);
+
+  //Now the first pattern can never match instead
+  session.fileStates.insert("a.esp", "Inactive");
+  conditions.compile(*document, session);
+  QCOMPARE(conditions.deadPatterns(), 1);
+}
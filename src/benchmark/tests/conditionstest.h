@@ -0,0 +1,27 @@
+#ifndef CONDITIONSTEST_H
+#define CONDITIONSTEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests comparing versions and compiling conditions with CompiledConditions
+ */
+class ConditionsTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void packsVersions();
+  void comparesUnpackedVersions_data();
+  void comparesUnpackedVersions();
+  void foldsUnpackedVersions_data();
+  void foldsUnpackedVersions();
+  void foldsFileDependencies();
+  void foldsDecidedGroups();
+  void flattensAndReorders();
+  void countsDeadConditions();
+
+};
+
+#endif // CONDITIONSTEST_H
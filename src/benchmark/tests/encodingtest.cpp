@@ -0,0 +1,188 @@
+#include "encodingtest.h"
+
+#include "encodingsniffer.h"
+#include "fomodparser.h"
+#include "utility.h"
+#include "xmlreader.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QTest>
+#include <QTextCodec>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+#include <memory>
+
+
+Q_DECLARE_METATYPE(EncodingSniffer::Encoding)
+
+
+namespace {
+
+// the samples are stored as raw bytes, the expected names are spelled out in utf-8 so this
+// file doesn't depend on the encoding the compiler assumes for its source
+const char *const UNICODE_NAME = "\xc3\x9c" "berarbeitete Texturen \xe2\x80\x93 \xce\xa9";
+const char *const LATIN1_NAME = "\xc3\x9c" "berarbeitete Texturen f\xc3\xbcr Caf\xc3\xa9";
+const char *const AUTHOR = "Zo\xc3\xab";
+
+QString samplePath(const char *fileName)
+{
+  return QString(TEST_DATA_DIR "/encoding/") + fileName;
+}
+
+QByteArray readSample(const char *fileName)
+{
+  QFile file(samplePath(fileName));
+  return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// skipXmlHeader from before the EncodingSniffer. The byte order marks are compared with
+// their length here, the original compared them as zero terminated strings
+QByteArray skipXmlHeader(QIODevice &file)
+{
+  static const char UTF16LE_BOM[] = { '\xFF', '\xFE' };
+  static const char UTF16BE_BOM[] = { '\xFE', '\xFF' };
+  static const char UTF8_BOM[]    = { '\xEF', '\xBB', '\xBF' };
+  static const char UTF16LE[]     = { 0x3C, 0x00, 0x3F, 0x00 };
+  static const char UTF16BE[]     = { 0x00, 0x3C, 0x00, 0x3F };
+  static const char UTF8[]        = { 0x3C, 0x3F, 0x78, 0x6D };
+
+  file.seek(0);
+  QByteArray rawBytes = file.read(4);
+  QTextStream stream(&file);
+  int bom = 0;
+  if (rawBytes.startsWith(QByteArray(UTF16LE_BOM, 2))) {
+    stream.setCodec("UTF16-LE");
+    bom = 2;
+  } else if (rawBytes.startsWith(QByteArray(UTF16BE_BOM, 2))) {
+    stream.setCodec("UTF16-BE");
+    bom = 2;
+  } else if (rawBytes.startsWith(QByteArray(UTF8_BOM, 3))) {
+    stream.setCodec("UTF-8");
+    bom = 3;
+  } else if (rawBytes.startsWith(QByteArray(UTF16LE, 4))) {
+    stream.setCodec("UTF16-LE");
+  } else if (rawBytes.startsWith(QByteArray(UTF16BE, 4))) {
+    stream.setCodec("UTF16-BE");
+  } else if (rawBytes.startsWith(QByteArray(UTF8, 4))) {
+    stream.setCodec("UTF-8");
+  }
+
+  stream.seek(bom);
+  QString header = stream.readLine();
+  if (!header.startsWith("<?")) {
+    stream.seek(bom);
+  }
+  file.seek(stream.pos());
+  return file.readAll();
+}
+
+// the info.xml fallback from before the EncodingSniffer: a strict attempt, then the document
+// without its header prefixed with a header for utf-16, utf-8 and iso-8859-1 in turn
+bool legacyReadInfo(const QByteArray &data, FomodInfo &info)
+{
+  QBuffer buffer;
+  buffer.setData(data);
+  buffer.open(QIODevice::ReadOnly);
+  try {
+    FomodInfo result;
+    QXmlStreamReader reader(&buffer);
+    FomodParser::parseInfo(reader, result);
+    info = result;
+    return true;
+  } catch (const XmlParseError&) {
+  }
+
+  QByteArray headerlessData = skipXmlHeader(buffer);
+  for (const char *encoding : { "utf-16", "utf-8", "iso-8859-1" }) {
+    try {
+      QTextCodec *codec = QTextCodec::codecForName(encoding);
+      FomodInfo result;
+      XmlReader reader(codec->fromUnicode(QString("<?xml version=\"1.0\" encoding=\"%1\" ?>").arg(encoding)) + headerlessData);
+      FomodParser::parseInfo(reader, result);
+      info = result;
+      return true;
+    } catch (const XmlParseError&) {
+    }
+  }
+  return false;
+}
+
+}
+
+
+void EncodingTest::detectsEncoding_data()
+{
+  QTest::addColumn<QString>("fileName");
+  QTest::addColumn<EncodingSniffer::Encoding>("encoding");
+  QTest::addColumn<bool>("matches");
+
+  QTest::newRow("utf-16 declared utf-8") << "utf16le-declared-utf8.xml" << EncodingSniffer::ENCODING_UTF16LE << false;
+  QTest::newRow("utf-8 declared utf-16") << "utf8-declared-utf16.xml" << EncodingSniffer::ENCODING_UTF8 << false;
+  QTest::newRow("latin-1 declared utf-8") << "latin1-declared-utf8.xml" << EncodingSniffer::ENCODING_LATIN1 << false;
+  QTest::newRow("utf-8 bom declared utf-16") << "bom-utf8-declared-utf16.xml" << EncodingSniffer::ENCODING_UTF8 << false;
+  QTest::newRow("utf-16be undeclared") << "utf16be-no-declaration.xml" << EncodingSniffer::ENCODING_UTF16BE << true;
+  QTest::newRow("latin-1 undeclared") << "latin1-no-declaration.xml" << EncodingSniffer::ENCODING_LATIN1 << false;
+  QTest::newRow("windows-1252") << "cp1252-declared-windows1252.xml" << EncodingSniffer::ENCODING_LATIN1 << true;
+  QTest::newRow("utf-8 declared iso-8859-1") << "utf8-declared-iso88591.xml" << EncodingSniffer::ENCODING_UTF8 << true;
+  QTest::newRow("unknown encoding") << "unknown-encoding.xml" << EncodingSniffer::ENCODING_LATIN1 << false;
+}
+
+void EncodingTest::detectsEncoding()
+{
+  QFETCH(QString, fileName);
+  QFETCH(EncodingSniffer::Encoding, encoding);
+  QFETCH(bool, matches);
+
+  QByteArray data = readSample(qPrintable(fileName));
+  QVERIFY(!data.isEmpty());
+  EncodingSniffer sniffer(data.constData(), static_cast<std::size_t>(data.size()));
+  QCOMPARE(sniffer.encoding(), encoding);
+  QCOMPARE(sniffer.declarationMatches(), matches);
+}
+
+void EncodingTest::matchesLegacyFallback_data()
+{
+  QTest::addColumn<QString>("fileName");
+  QTest::addColumn<QString>("name");
+
+  QTest::newRow("utf-16 declared utf-8") << "utf16le-declared-utf8.xml" << QString::fromUtf8(UNICODE_NAME);
+  QTest::newRow("utf-8 declared utf-16") << "utf8-declared-utf16.xml" << QString::fromUtf8(UNICODE_NAME);
+  QTest::newRow("latin-1 declared utf-8") << "latin1-declared-utf8.xml" << QString::fromUtf8(LATIN1_NAME);
+  QTest::newRow("utf-8 bom declared utf-16") << "bom-utf8-declared-utf16.xml" << QString::fromUtf8(UNICODE_NAME);
+  QTest::newRow("utf-16be undeclared") << "utf16be-no-declaration.xml" << QString::fromUtf8(UNICODE_NAME);
+  QTest::newRow("latin-1 undeclared") << "latin1-no-declaration.xml" << QString::fromUtf8(LATIN1_NAME);
+  QTest::newRow("windows-1252") << "cp1252-declared-windows1252.xml"
+                                << QString::fromUtf8("\xe2\x80\x9c" "Euro\xe2\x80\x9d \xe2\x82\xac" "5");
+  //Declared 8-bit codepages are trusted, as before
+  QTest::newRow("utf-8 declared iso-8859-1") << "utf8-declared-iso88591.xml" << QString::fromLatin1("Caf\xc3\xa9");
+  QTest::newRow("unknown encoding") << "unknown-encoding.xml" << QString::fromUtf8(LATIN1_NAME);
+}
+
+void EncodingTest::matchesLegacyFallback()
+{
+  QFETCH(QString, fileName);
+  QFETCH(QString, name);
+
+  FomodInfo info;
+  QVERIFY(FomodParser::readInfo(samplePath(qPrintable(fileName)), info));
+  QCOMPARE(info.m_Name, name);
+  QCOMPARE(info.m_Author, QString::fromUtf8(AUTHOR));
+
+  //The old chain only recognised utf-16 with a byte order mark if the platform knew its
+  //misspelled codec names, so where it failed there is nothing to compare against
+  FomodInfo legacy;
+  if (legacyReadInfo(readSample(qPrintable(fileName)), legacy)) {
+    QCOMPARE(info.m_Name, legacy.m_Name);
+    QCOMPARE(info.m_Author, legacy.m_Author);
+  }
+}
+
+void EncodingTest::decodesModuleConfig()
+{
+  std::unique_ptr<FomodDocument> document =
+      FomodParser::readModuleConfig(samplePath("moduleconfig-utf8-declared-utf16.xml"));
+  QVERIFY(document.get() != nullptr);
+  QCOMPARE(document->m_ModuleName, QString::fromUtf8(UNICODE_NAME));
+}
@@ -0,0 +1,24 @@
+#ifndef ENCODINGTEST_H
+#define ENCODINGTEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests the EncodingSniffer against the samples in data/encoding and compares the
+ *        documents read with it to those the previous fallback chain produced
+ */
+class EncodingTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void detectsEncoding_data();
+  void detectsEncoding();
+  void matchesLegacyFallback_data();
+  void matchesLegacyFallback();
+  void decodesModuleConfig();
+
+};
+
+#endif // ENCODINGTEST_H
@@ -0,0 +1,104 @@
+#include "flagstatetest.h"
+
+#include "flagstate.h"
+
+#include <QTest>
+
+#include <algorithm>
+
+
+namespace {
+
+const int EMPTY = CompiledConditions::EMPTY_VALUE;
+
+// flag and value ids as CompiledConditions would intern them
+enum { FLAG_A, FLAG_B, FLAG_C };
+enum { VALUE_ON = 1, VALUE_OFF, VALUE_HIGH };
+
+std::vector<int> sorted(std::vector<int> flags)
+{
+  std::sort(flags.begin(), flags.end());
+  flags.erase(std::unique(flags.begin(), flags.end()), flags.end());
+  return flags;
+}
+
+}
+
+
+void FlagStateTest::readsEarlierPages()
+{
+  FlagState state;
+  state.enterPage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_ON } });
+  state.enterPage(2, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_OFF }, { FLAG_B, VALUE_HIGH } });
+
+  //Only pages before maxIndex count
+  QCOMPARE(state.value(FLAG_A, 0), EMPTY);
+  QCOMPARE(state.value(FLAG_A, 1), static_cast<int>(VALUE_ON));
+  QCOMPARE(state.value(FLAG_A, 2), static_cast<int>(VALUE_ON));
+  QCOMPARE(state.value(FLAG_A, 3), static_cast<int>(VALUE_OFF));
+  QCOMPARE(state.value(FLAG_B, 2), EMPTY);
+  QCOMPARE(state.value(FLAG_B, 3), static_cast<int>(VALUE_HIGH));
+  QCOMPARE(state.value(FLAG_C, 3), EMPTY);
+
+  QCOMPARE(sorted(state.takeChangedFlags()), (std::vector<int>{ FLAG_A, FLAG_B }));
+  QVERIFY(state.takeChangedFlags().empty());
+}
+
+void FlagStateTest::leavesPages()
+{
+  FlagState state;
+  state.enterPage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_ON } });
+  state.enterPage(1, CompiledConditions::FlagValueList{ { FLAG_B, VALUE_ON } });
+  state.enterPage(3, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_OFF } });
+  state.takeChangedFlags();
+
+  state.leavePages(1);
+  QCOMPARE(state.value(FLAG_A, 4), static_cast<int>(VALUE_ON));
+  QCOMPARE(state.value(FLAG_B, 4), EMPTY);
+  QCOMPARE(sorted(state.takeChangedFlags()), (std::vector<int>{ FLAG_A, FLAG_B }));
+
+  //Pages can be entered again after leaving them
+  state.enterPage(1, CompiledConditions::FlagValueList{ { FLAG_C, VALUE_HIGH } });
+  QCOMPARE(state.value(FLAG_C, 2), static_cast<int>(VALUE_HIGH));
+}
+
+void FlagStateTest::updatesLastPage()
+{
+  FlagState state;
+  state.enterPage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_ON } });
+  state.enterPage(1, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_OFF }, { FLAG_B, VALUE_ON } });
+  state.takeChangedFlags();
+
+  //A keeps its value, B is removed and C added
+  state.updatePage(1, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_OFF }, { FLAG_C, VALUE_ON } });
+  QCOMPARE(sorted(state.takeChangedFlags()), (std::vector<int>{ FLAG_B, FLAG_C }));
+  QCOMPARE(state.value(FLAG_A, 2), static_cast<int>(VALUE_OFF));
+  QCOMPARE(state.value(FLAG_B, 2), EMPTY);
+  QCOMPARE(state.value(FLAG_C, 2), static_cast<int>(VALUE_ON));
+
+  state.updatePage(1, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_HIGH }, { FLAG_C, VALUE_ON } });
+  QCOMPARE(sorted(state.takeChangedFlags()), std::vector<int>{ FLAG_A });
+  QCOMPARE(state.value(FLAG_A, 1), static_cast<int>(VALUE_ON));
+  QCOMPARE(state.value(FLAG_A, 2), static_cast<int>(VALUE_HIGH));
+}
+
+void FlagStateTest::ignoresUpdateOfEarlierPage()
+{
+  FlagState state;
+  state.enterPage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_ON } });
+  state.enterPage(1, CompiledConditions::FlagValueList{ { FLAG_B, VALUE_ON } });
+  state.takeChangedFlags();
+
+  state.updatePage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_OFF } });
+  QVERIFY(state.takeChangedFlags().empty());
+  QCOMPARE(state.value(FLAG_A, 2), static_cast<int>(VALUE_ON));
+}
+
+void FlagStateTest::clears()
+{
+  FlagState state;
+  state.enterPage(0, CompiledConditions::FlagValueList{ { FLAG_A, VALUE_ON } });
+  state.clear();
+  QCOMPARE(state.value(FLAG_A, 1), EMPTY);
+  QVERIFY(state.takeChangedFlags().empty());
+}
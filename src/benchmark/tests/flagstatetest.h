@@ -0,0 +1,23 @@
+#ifndef FLAGSTATETEST_H
+#define FLAGSTATETEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests tracking flag values across pages with FlagState
+ */
+class FlagStateTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void readsEarlierPages();
+  void leavesPages();
+  void updatesLastPage();
+  void ignoresUpdateOfEarlierPage();
+  void clears();
+
+};
+
+#endif // FLAGSTATETEST_H
@@ -0,0 +1,121 @@
+#include "installplantest.h"
+
+#include "fomodparser.h"
+#include "installplan.h"
+#include "xmlreader.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTest>
+
+#include <memory>
+
+
+namespace {
+
+const char *const MODULE_CONFIG =
+  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+  "<config>\n"
+  "  <moduleName>Test Mod</moduleName>\n"
+  "  <requiredInstallFiles>\n"
+  "    <folder source=\"Core\" destination=\"\"/>\n"
+  "    <folder source=\"Extra\\\" destination=\"/\"/>\n"
+  "    <file source=\"Option\\a.esp\" destination=\"a.esp\"/>\n"
+  "    <file source=\"Other/A.ESP\" destination=\"\\\"/>\n"
+  "    <folder source=\"Textures\" destination=\"textures\"/>\n"
+  "    <file source=\"Option\\b.dds\" destination=\"Textures/b.dds\"/>\n"
+  "    <file source=\"Third/a.esp\" destination=\"a.esp\"/>\n"
+  "  </requiredInstallFiles>\n"
+  "</config>\n";
+
+InstallPlan makePlan()
+{
+  FomodDocument document;
+  QByteArray data(MODULE_CONFIG);
+  XmlReader reader(data);
+  FomodParser parser(document);
+  parser.parseModuleConfig(reader);
+
+  InstallPlan result;
+  for (const FileDescriptor *file : document.m_RequiredFiles) {
+    result.add(document, *file);
+  }
+  return result;
+}
+
+// everything a plan stores, one line per operation and conflict
+QStringList describe(const InstallPlan &plan)
+{
+  QStringList result;
+  for (const InstallPlan::Operation &operation : plan.operations()) {
+    result.append(QString("%1|%2 -> %3|%4 folder %5 priority %6 sequence %7")
+                  .arg(plan.string(operation.source.m_Directory))
+                  .arg(plan.string(operation.source.m_Name))
+                  .arg(plan.string(operation.destination.m_Directory))
+                  .arg(plan.string(operation.destination.m_Name))
+                  .arg(operation.folder).arg(operation.priority).arg(operation.sequence));
+  }
+  for (const InstallPlan::Conflict &conflict : plan.conflicts()) {
+    result.append(QString("conflict %1 -> %2").arg(conflict.overridden).arg(conflict.winner));
+  }
+  return result;
+}
+
+}
+
+
+void InstallPlanTest::recordsFileConflicts()
+{
+  InstallPlan plan = makePlan();
+  QCOMPARE(plan.operations().size(), size_t(7));
+
+  //Files are compared case insensitively, without a destination name they keep the
+  //source name. Folders merging into the same directory don't conflict, neither do
+  //files placed in a folder's destination
+  QStringList conflicts = describe(plan).filter("conflict");
+  QCOMPARE(conflicts, QStringList() << "conflict 2 -> 3" << "conflict 3 -> 6");
+}
+
+void InstallPlanTest::roundTripsBinary()
+{
+  InstallPlan plan = makePlan();
+  QByteArray data = plan.toBinary();
+  std::unique_ptr<InstallPlan> loaded = InstallPlan::fromBinary(data);
+  QVERIFY(loaded.get() != nullptr);
+  QCOMPARE(describe(*loaded), describe(plan));
+  QCOMPARE(loaded->toBinary(), data);
+}
+
+void InstallPlanTest::roundTripsJson()
+{
+  InstallPlan plan = makePlan();
+  QByteArray text = plan.toJson().toJson();
+  std::unique_ptr<InstallPlan> loaded = InstallPlan::fromJson(QJsonDocument::fromJson(text));
+  QVERIFY(loaded.get() != nullptr);
+  QCOMPARE(describe(*loaded), describe(plan));
+  QCOMPARE(loaded->toJson().toJson(), text);
+}
+
+void InstallPlanTest::rejectsMismatchedConflicts()
+{
+  //The plan ends with the winner of the last conflict
+  QByteArray data = makePlan().toBinary();
+  data[data.size() - 1] = static_cast<char>(data.at(data.size() - 1) ^ 1);
+
+  QTest::ignoreMessage(QtDebugMsg, "invalid install plan: conflicts don't match operations");
+  QVERIFY(InstallPlan::fromBinary(data).get() == nullptr);
+}
+
+void InstallPlanTest::rejectsMissingFolderFlag()
+{
+  QJsonObject root = makePlan().toJson().object();
+  QJsonArray operations = root.value("operations").toArray();
+  QJsonObject operation = operations.at(1).toObject();
+  operation.remove("folder");
+  operations.replace(1, operation);
+  root.insert("operations", operations);
+
+  QTest::ignoreMessage(QtDebugMsg, "invalid install plan: missing folder flag");
+  QVERIFY(InstallPlan::fromJson(QJsonDocument(root)).get() == nullptr);
+}
@@ -0,0 +1,23 @@
+#ifndef INSTALLPLANTEST_H
+#define INSTALLPLANTEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests building an InstallPlan and writing it in binary and json form
+ */
+class InstallPlanTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void recordsFileConflicts();
+  void roundTripsBinary();
+  void roundTripsJson();
+  void rejectsMismatchedConflicts();
+  void rejectsMissingFolderFlag();
+
+};
+
+#endif // INSTALLPLANTEST_H
@@ -0,0 +1,42 @@
+/*
+Unit tests for the parts of the fomod installer that don't need Mod Organizer. Each test class
+covers one module, all of them are run by this executable.
+*/
+
+#include "cachetest.h"
+#include "conditionstest.h"
+#include "encodingtest.h"
+#include "flagstatetest.h"
+#include "installplantest.h"
+#include "parsertest.h"
+
+#include <QCoreApplication>
+#include <QTest>
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  int failures = 0;
+
+  ParserTest parserTest;
+  failures += QTest::qExec(&parserTest, argc, argv);
+
+  CacheTest cacheTest;
+  failures += QTest::qExec(&cacheTest, argc, argv);
+
+  ConditionsTest conditionsTest;
+  failures += QTest::qExec(&conditionsTest, argc, argv);
+
+  EncodingTest encodingTest;
+  failures += QTest::qExec(&encodingTest, argc, argv);
+
+  FlagStateTest flagStateTest;
+  failures += QTest::qExec(&flagStateTest, argc, argv);
+
+  InstallPlanTest installPlanTest;
+  failures += QTest::qExec(&installPlanTest, argc, argv);
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+#include "parsertest.h"
+
+#include "fomodparser.h"
+#include "utility.h"
+#include "xmlreader.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+
+namespace {
+
+QByteArray moduleConfig(const char *content)
+{
+  return QByteArray("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+                    "<config>\n"
+                    "  <moduleName>Test Mod</moduleName>\n")
+         + content
+         + "</config>\n";
+}
+
+std::unique_ptr<FomodDocument> parse(const QByteArray &data, ParseDiagnostics *diagnostics = nullptr)
+{
+  std::unique_ptr<FomodDocument> document(new FomodDocument);
+  XmlReader reader(data);
+  FomodParser parser(*document);
+  parser.parseModuleConfig(reader);
+  if (diagnostics != nullptr) {
+    *diagnostics = reader.diagnostics();
+  }
+  return document;
+}
+
+QString pathString(const FomodDocument &document, const DescriptorPath &path)
+{
+  return document.string(path.m_Directory) + "|" + document.string(path.m_Name);
+}
+
+}
+
+
+void ParserTest::readsModuleConfig()
+{
+  std::unique_ptr<FomodDocument> document = parse(moduleConfig(
+    "  <moduleDependencies operator=\"Or\">\n"
+    "    <fileDependency file=\"Base.esm\" state=\"Active\"/>\n"
+    "    <gameDependency version=\"1.2\"/>\n"
+    "  </moduleDependencies>\n"
+    "  <requiredInstallFiles>\n"
+    "    <folder source=\"core\\Meshes\\\" destination=\"Meshes\"/>\n"
+    "    <file source=\"docs/readme.txt\"/>\n"
+    "  </requiredInstallFiles>\n"
+    "  <installSteps order=\"Explicit\">\n"
+    "    <installStep name=\"Textures\">\n"
+    "      <visible>\n"
+    "        <flagDependency flag=\"quality\" value=\"high\"/>\n"
+    "      </visible>\n"
+    "      <optionalFileGroups>\n"
+    "        <group name=\"Resolution\" type=\"SelectExactlyOne\">\n"
+    "          <plugins>\n"
+    "            <plugin name=\"2K\">\n"
+    "              <description> Sharp </description>\n"
+    "              <image path=\"images\\2k.png\"/>\n"
+    "              <conditionFlags><flag name=\"quality\">high</flag></conditionFlags>\n"
+    "              <files>\n"
+    "                <file source=\"2k\\a.dds\" destination=\"Textures\\a.dds\" priority=\"2\"/>\n"
+    "                <file source=\"2k\\b.dds\" destination=\"Textures\\b.dds\"/>\n"
+    "              </files>\n"
+    "              <typeDescriptor><type name=\"Recommended\"/></typeDescriptor>\n"
+    "            </plugin>\n"
+    "            <plugin name=\"1K\">\n"
+    "              <typeDescriptor><type name=\"Optional\"/></typeDescriptor>\n"
+    "            </plugin>\n"
+    "          </plugins>\n"
+    "        </group>\n"
+    "      </optionalFileGroups>\n"
+    "    </installStep>\n"
+    "    <installStep name=\"Meshes\">\n"
+    "      <optionalFileGroups/>\n"
+    "    </installStep>\n"
+    "  </installSteps>\n"));
+
+  QCOMPARE(document->m_ModuleName, QString("Test Mod"));
+
+  QCOMPARE(document->m_ModuleDependencies.m_Operator, OP_OR);
+  QCOMPARE(document->m_ModuleDependencies.m_Count, 2);
+  const Condition &file = document->condition(document->m_ModuleDependencies.m_First);
+  QCOMPARE(file.m_Type, Condition::TYPE_FILE);
+  QCOMPARE(document->string(file.m_Name), QString("Base.esm"));
+  QCOMPARE(document->string(file.m_Value), QString("Active"));
+  const Condition &version = document->condition(document->m_ModuleDependencies.m_First + 1);
+  QCOMPARE(version.m_Type, Condition::TYPE_VERSION);
+  QCOMPARE(version.m_VersionType, Condition::VERSION_GAME);
+  QCOMPARE(document->string(version.m_Name), QString("1.2"));
+
+  QCOMPARE(document->m_RequiredFiles.size(), size_t(2));
+  const FileDescriptor *folder = document->m_RequiredFiles[0];
+  QVERIFY(folder->m_IsFolder);
+  QCOMPARE(document->string(folder->m_Source), QString("core\\Meshes\\"));
+  QCOMPARE(pathString(*document, folder->m_SourcePath), QString("core/Meshes|"));
+  QCOMPARE(pathString(*document, folder->m_DestinationPath), QString("Meshes|"));
+  const FileDescriptor *readme = document->m_RequiredFiles[1];
+  QVERIFY(!readme->m_IsFolder);
+  QCOMPARE(document->string(readme->m_Destination), QString("docs/readme.txt"));
+  QCOMPARE(pathString(*document, readme->m_DestinationPath), QString("docs|readme.txt"));
+  QVERIFY(folder->m_FileSystemItemSequence < readme->m_FileSystemItemSequence);
+
+  //Explicit order keeps the steps as written
+  QCOMPARE(document->m_Steps.size(), size_t(2));
+  const InstallStep &step = document->m_Steps[0];
+  QCOMPARE(step.m_Name, QString("Textures"));
+  QCOMPARE(document->m_Steps[1].m_Name, QString("Meshes"));
+  QCOMPARE(step.m_Visible.m_Count, 1);
+  const Condition &flag = document->condition(step.m_Visible.m_First);
+  QCOMPARE(flag.m_Type, Condition::TYPE_FLAG);
+  QCOMPARE(document->string(flag.m_Name), QString("quality"));
+  QCOMPARE(document->string(flag.m_Value), QString("high"));
+
+  QCOMPARE(step.m_Groups.size(), size_t(1));
+  const Group &group = step.m_Groups[0];
+  QCOMPARE(group.m_Name, QString("Resolution"));
+  QCOMPARE(group.m_Type, TYPE_SELECTEXACTLYONE);
+
+  //Plugins are sorted ascending by default
+  QCOMPARE(group.m_Plugins.size(), size_t(2));
+  QCOMPARE(group.m_Plugins[0].m_Name, QString("1K"));
+  QCOMPARE(group.m_Plugins[0].m_PluginTypeInfo.m_DefaultType, TYPE_OPTIONAL);
+  const Plugin &plugin = group.m_Plugins[1];
+  QCOMPARE(plugin.m_Name, QString("2K"));
+  QCOMPARE(plugin.m_Description, QString("Sharp"));
+  QCOMPARE(plugin.m_ImagePath, QString("images\\2k.png"));
+  QCOMPARE(plugin.m_PluginTypeInfo.m_DefaultType, TYPE_RECOMMENDED);
+  QVERIFY(plugin.m_PluginTypeInfo.m_DependencyPatterns.empty());
+  QCOMPARE(plugin.m_ConditionFlags.size(), size_t(1));
+  QCOMPARE(plugin.m_ConditionFlags[0].m_Name, QString("quality"));
+  QCOMPARE(plugin.m_ConditionFlags[0].m_Value, QString("high"));
+
+  //Files are sorted by priority
+  QCOMPARE(plugin.m_Files.size(), size_t(2));
+  QCOMPARE(document->string(plugin.m_Files[0]->m_Source), QString("2k\\b.dds"));
+  QCOMPARE(plugin.m_Files[0]->m_Priority, 0);
+  QCOMPARE(document->string(plugin.m_Files[1]->m_Source), QString("2k\\a.dds"));
+  QCOMPARE(plugin.m_Files[1]->m_Priority, 2);
+  QCOMPARE(pathString(*document, plugin.m_Files[1]->m_DestinationPath), QString("Textures|a.dds"));
+  QCOMPARE(document->string(plugin.m_Files[1]->m_DestinationPath.m_DirectoryKey), QString("textures"));
+}
+
+void ParserTest::readsDependencyPatterns()
+{
+  std::unique_ptr<FomodDocument> document = parse(moduleConfig(
+    "  <installSteps>\n"
+    "    <installStep name=\"Options\">\n"
+    "      <optionalFileGroups>\n"
+    "        <group name=\"Patches\" type=\"SelectAny\">\n"
+    "          <plugins>\n"
+    "            <plugin name=\"Patch\">\n"
+    "              <typeDescriptor>\n"
+    "                <dependencyType>\n"
+    "                  <defaultType name=\"Optional\"/>\n"
+    "                  <patterns>\n"
+    "                    <pattern>\n"
+    "                      <dependencies operator=\"And\">\n"
+    "                        <flagDependency flag=\"quality\" value=\"low\"/>\n"
+    "                        <dependencies operator=\"Or\">\n"
+    "                          <fileDependency file=\"a.esp\" state=\"Missing\"/>\n"
+    "                          <fommDependency version=\"0.13\"/>\n"
+    "                        </dependencies>\n"
+    "                      </dependencies>\n"
+    "                      <type name=\"NotUsable\"/>\n"
+    "                    </pattern>\n"
+    "                    <pattern>\n"
+    "                      <dependencies>\n"
+    "                        <foseDependency version=\"2.0\"/>\n"
+    "                      </dependencies>\n"
+    "                      <type name=\"Required\"/>\n"
+    "                    </pattern>\n"
+    "                  </patterns>\n"
+    "                </dependencyType>\n"
+    "              </typeDescriptor>\n"
+    "            </plugin>\n"
+    "            <plugin name=\"Other\"/>\n"
+    "          </plugins>\n"
+    "        </group>\n"
+    "      </optionalFileGroups>\n"
+    "    </installStep>\n"
+    "  </installSteps>\n"));
+
+  const PluginTypeInfo &info = document->m_Steps[0].m_Groups[0].m_Plugins[1].m_PluginTypeInfo;
+  QCOMPARE(info.m_DefaultType, TYPE_OPTIONAL);
+  QCOMPARE(info.m_DependencyPatterns.size(), size_t(2));
+
+  const DependencyPattern &first = info.m_DependencyPatterns[0];
+  QCOMPARE(first.type, TYPE_NOTUSABLE);
+  QCOMPARE(first.condition.m_Operator, OP_AND);
+  QCOMPARE(first.condition.m_Count, 2);
+  QCOMPARE(document->condition(first.condition.m_First).m_Type, Condition::TYPE_FLAG);
+  const Condition &nested = document->condition(first.condition.m_First + 1);
+  QCOMPARE(nested.m_Type, Condition::TYPE_SUB);
+  QCOMPARE(nested.m_Sub.m_Operator, OP_OR);
+  QCOMPARE(nested.m_Sub.m_Count, 2);
+  QCOMPARE(document->condition(nested.m_Sub.m_First).m_Type, Condition::TYPE_FILE);
+  const Condition &fomm = document->condition(nested.m_Sub.m_First + 1);
+  QCOMPARE(fomm.m_Type, Condition::TYPE_VERSION);
+  QCOMPARE(fomm.m_VersionType, Condition::VERSION_FOMM);
+
+  const DependencyPattern &second = info.m_DependencyPatterns[1];
+  QCOMPARE(second.type, TYPE_REQUIRED);
+  QCOMPARE(second.condition.m_Count, 1);
+  QCOMPARE(document->condition(second.condition.m_First).m_VersionType, Condition::VERSION_FOSE);
+}
+
+void ParserTest::sortsSteps()
+{
+  const char *steps =
+    "    <installStep name=\"B\"><optionalFileGroups/></installStep>\n"
+    "    <installStep name=\"C\"><optionalFileGroups/></installStep>\n"
+    "    <installStep name=\"A\"><optionalFileGroups/></installStep>\n";
+
+  std::unique_ptr<FomodDocument> ascending = parse(moduleConfig(
+    (QByteArray("  <installSteps>\n") + steps + "  </installSteps>\n").constData()));
+  QCOMPARE(ascending->m_Steps.size(), size_t(3));
+  QCOMPARE(ascending->m_Steps[0].m_Name, QString("A"));
+  QCOMPARE(ascending->m_Steps[2].m_Name, QString("C"));
+
+  std::unique_ptr<FomodDocument> descending = parse(moduleConfig(
+    (QByteArray("  <installSteps order=\"Descending\">\n") + steps + "  </installSteps>\n").constData()));
+  QCOMPARE(descending->m_Steps[0].m_Name, QString("C"));
+  QCOMPARE(descending->m_Steps[2].m_Name, QString("A"));
+}
+
+void ParserTest::correctsSinglePluginGroups()
+{
+  std::unique_ptr<FomodDocument> document = parse(moduleConfig(
+    "  <installSteps>\n"
+    "    <installStep name=\"Step\">\n"
+    "      <optionalFileGroups>\n"
+    "        <group name=\"Exactly\" type=\"SelectExactlyOne\">\n"
+    "          <plugins><plugin name=\"Only\"/></plugins>\n"
+    "        </group>\n"
+    "        <group name=\"AtMost\" type=\"SelectAtMostOne\">\n"
+    "          <plugins><plugin name=\"Only\"/></plugins>\n"
+    "        </group>\n"
+    "      </optionalFileGroups>\n"
+    "    </installStep>\n"
+    "  </installSteps>\n"));
+
+  const std::vector<Group> &groups = document->m_Steps[0].m_Groups;
+  QCOMPARE(groups.size(), size_t(2));
+  QCOMPARE(groups[0].m_Type, TYPE_SELECTALL);
+  QCOMPARE(groups[1].m_Type, TYPE_SELECTANY);
+}
+
+void ParserTest::readsConditionalInstalls()
+{
+  std::unique_ptr<FomodDocument> document = parse(moduleConfig(
+    "  <conditionalFileInstalls>\n"
+    "    <patterns>\n"
+    "      <pattern>\n"
+    "        <dependencies operator=\"Or\">\n"
+    "          <flagDependency flag=\"a\" value=\"1\"/>\n"
+    "          <flagDependency flag=\"b\" value=\"\"/>\n"
+    "        </dependencies>\n"
+    "        <files>\n"
+    "          <folder source=\"extra\" destination=\"\" priority=\"-1\"/>\n"
+    "        </files>\n"
+    "      </pattern>\n"
+    "    </patterns>\n"
+    "  </conditionalFileInstalls>\n"));
+
+  QCOMPARE(document->m_ConditionalInstalls.size(), size_t(1));
+  const ConditionalInstall &install = document->m_ConditionalInstalls[0];
+  QCOMPARE(install.m_Condition.m_Operator, OP_OR);
+  QCOMPARE(install.m_Condition.m_Count, 2);
+  QVERIFY(document->string(document->condition(install.m_Condition.m_First + 1).m_Value).isEmpty());
+  QCOMPARE(install.m_Files.size(), size_t(1));
+  QVERIFY(install.m_Files[0]->m_IsFolder);
+  QCOMPARE(install.m_Files[0]->m_Priority, -1);
+  //An empty destination is the root of the mod, not the source path
+  QCOMPARE(pathString(*document, install.m_Files[0]->m_DestinationPath), QString("|"));
+}
+
+void ParserTest::skipsEmptySources()
+{
+  ParseDiagnostics diagnostics;
+  std::unique_ptr<FomodDocument> document = parse(moduleConfig(
+    "  <requiredInstallFiles>\n"
+    "    <folder source=\"\" destination=\"\"/>\n"
+    "    <file source=\"a.esp\"/>\n"
+    "  </requiredInstallFiles>\n"), &diagnostics);
+
+  QCOMPARE(document->m_RequiredFiles.size(), size_t(1));
+  QCOMPARE(document->fileDescriptors().size(), size_t(1));
+  QCOMPARE(diagnostics.count(), 1);
+  QCOMPARE(diagnostics.entries()[0].code, ParseDiagnostics::DIAG_EMPTY_SOURCE);
+}
+
+void ParserTest::capsDiagnostics()
+{
+  ParseDiagnostics diagnostics;
+  for (int i = 0; i < 1000; ++i) {
+    QString name = QString("element%1").arg(i);
+    diagnostics.report(ParseDiagnostics::DIAG_UNEXPECTED_ELEMENT, QStringRef(&name), i + 1);
+  }
+  //Repeats of a kept entry are still counted once the entries are full
+  QString first("element0");
+  diagnostics.report(ParseDiagnostics::DIAG_UNEXPECTED_ELEMENT, QStringRef(&first), 2000);
+  diagnostics.reportToken(QXmlStreamReader::Characters, 2001);
+
+  QCOMPARE(diagnostics.count(), 1002);
+  QCOMPARE(diagnostics.entries().size(), size_t(100));
+  QCOMPARE(diagnostics.entries()[0].count, 2);
+  QCOMPARE(diagnostics.elementName(diagnostics.entries()[99]), QString("element99"));
+  QVERIFY(diagnostics.summary().endsWith("901 more"));
+}
+
+void ParserTest::rejectsWrongRoot()
+{
+  QVERIFY_EXCEPTION_THROWN(parse("<?xml version=\"1.0\"?>\n<fomod/>\n"), XmlParseError);
+}
+
+void ParserTest::throwsOnMissingModuleConfig()
+{
+  QTemporaryDir directory;
+  QVERIFY_EXCEPTION_THROWN(FomodParser::readModuleConfig(directory.path() + "/ModuleConfig.xml"),
+                           MOBase::MyException);
+}
+
+void ParserTest::readsInfo()
+{
+  QTemporaryDir directory;
+  QFile file(directory.path() + "/info.xml");
+  QVERIFY(file.open(QIODevice::WriteOnly));
+  file.write("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+             "<fomod>\n"
+             "  <Name>Test Mod</Name>\n"
+             "  <Author>Someone</Author>\n"
+             "  <Version>1.0.2</Version>\n"
+             "  <Id>1234</Id>\n"
+             "  <Website>https://example.com/</Website>\n"
+             "</fomod>\n");
+  file.close();
+
+  FomodInfo info;
+  QVERIFY(FomodParser::readInfo(file.fileName(), info));
+  QCOMPARE(info.m_Name, QString("Test Mod"));
+  QCOMPARE(info.m_Author, QString("Someone"));
+  QCOMPARE(info.m_Version, QString("1.0.2"));
+  QCOMPARE(info.m_ModID, 1234);
+  QCOMPARE(info.m_Website, QString("https://example.com/"));
+}
+
+void ParserTest::ignoresMissingInfo()
+{
+  QTemporaryDir directory;
+  FomodInfo info;
+  info.m_Name = "unchanged";
+  QVERIFY(FomodParser::readInfo(directory.path() + "/info.xml", info));
+  QCOMPARE(info.m_Name, QString("unchanged"));
+}
@@ -0,0 +1,29 @@
+#ifndef PARSERTEST_H
+#define PARSERTEST_H
+
+#include <QObject>
+
+/**
+ * @brief tests reading ModuleConfig.xml and info.xml into a FomodDocument / FomodInfo
+ */
+class ParserTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void readsModuleConfig();
+  void readsDependencyPatterns();
+  void sortsSteps();
+  void correctsSinglePluginGroups();
+  void readsConditionalInstalls();
+  void skipsEmptySources();
+  void capsDiagnostics();
+  void rejectsWrongRoot();
+  void throwsOnMissingModuleConfig();
+  void readsInfo();
+  void ignoresMissingInfo();
+
+};
+
+#endif // PARSERTEST_H
@@ -0,0 +1,324 @@
+#include "compiledconditions.h"
+
+#include <QSet>
+
+#include <algorithm>
+
+
+namespace {
+
+void collectFiles(const FomodDocument &document, const SubCondition &condition,
+                  QStringList &files, QSet<QString> &seen)
+{
+  for (int i = 0; i < condition.m_Count; ++i) {
+    const Condition &child = document.condition(condition.m_First + i);
+    if (child.m_Type == Condition::TYPE_SUB) {
+      collectFiles(document, child.m_Sub, files, seen);
+    } else if (child.m_Type == Condition::TYPE_FILE) {
+      const QString &file = document.string(child.m_Name);
+      if (!seen.contains(file)) {
+        seen.insert(file);
+        files.append(file);
+      }
+    }
+  }
+}
+
+}
+
+
+const int CompiledConditions::EMPTY_VALUE;
+
+CompiledConditions::CompiledConditions()
+  : m_EliminatedNodes(0), m_ReorderedGroups(0), m_DeadPatterns(0), m_DeadInstalls(0)
+{
+  m_ValueIds.insert(QString(), EMPTY_VALUE);
+}
+
+QStringList CompiledConditions::fileDependencies(const FomodDocument &document)
+{
+  QStringList result;
+  QSet<QString> seen;
+  collectFiles(document, document.m_ModuleDependencies, result, seen);
+  for (const InstallStep &step : document.m_Steps) {
+    collectFiles(document, step.m_Visible, result, seen);
+    for (const Group &group : step.m_Groups) {
+      for (const Plugin &plugin : group.m_Plugins) {
+        for (const DependencyPattern &pattern : plugin.m_PluginTypeInfo.m_DependencyPatterns) {
+          collectFiles(document, pattern.condition, result, seen);
+        }
+      }
+    }
+  }
+  for (const ConditionalInstall &install : document.m_ConditionalInstalls) {
+    collectFiles(document, install.m_Condition, result, seen);
+  }
+  return result;
+}
+
+void CompiledConditions::compile(FomodDocument &document, const Session &session)
+{
+  m_Code.clear();
+  m_Programs.clear();
+  m_EliminatedNodes = 0;
+  m_ReorderedGroups = 0;
+  m_DeadPatterns = 0;
+  m_DeadInstalls = 0;
+  m_Statistics = Statistics();
+
+  document.m_ModuleDependencies.m_Index = add(document, document.m_ModuleDependencies, session);
+  for (InstallStep &step : document.m_Steps) {
+    step.m_Visible.m_Index = add(document, step.m_Visible, session);
+    for (Group &group : step.m_Groups) {
+      for (Plugin &plugin : group.m_Plugins) {
+        //The first matching pattern wins so everything after one that always
+        //matches is unreachable
+        bool reachable = true;
+        for (DependencyPattern &pattern : plugin.m_PluginTypeInfo.m_DependencyPatterns) {
+          pattern.condition.m_Index = add(document, pattern.condition, session);
+          if (!reachable || isConstant(pattern.condition.m_Index, false)) {
+            ++m_DeadPatterns;
+          } else if (isConstant(pattern.condition.m_Index, true)) {
+            reachable = false;
+          }
+        }
+      }
+    }
+  }
+  for (ConditionalInstall &install : document.m_ConditionalInstalls) {
+    install.m_Condition.m_Index = add(document, install.m_Condition, session);
+    if (isConstant(install.m_Condition.m_Index, false)) {
+      ++m_DeadInstalls;
+    }
+  }
+}
+
+bool CompiledConditions::isConstant(int index, bool value) const
+{
+  const Program &program = m_Programs[index];
+  return (program.end - program.begin == 1)
+      && (m_Code[program.begin].opcode == OPCODE_CONST)
+      && ((m_Code[program.begin].operand != 0) == value);
+}
+
+std::vector<int> CompiledConditions::flags(int index) const
+{
+  std::vector<int> result;
+  const Program &program = m_Programs[index];
+  for (int pc = program.begin; pc < program.end; ++pc) {
+    const Instruction &instruction = m_Code[pc];
+    if ((instruction.opcode == OPCODE_FLAG)
+        && (std::find(result.begin(), result.end(), instruction.operand) == result.end())) {
+      result.push_back(instruction.operand);
+    }
+  }
+  return result;
+}
+
+int CompiledConditions::flagId(const QString &name)
+{
+  auto iter = m_FlagIds.find(name);
+  if (iter == m_FlagIds.end()) {
+    iter = m_FlagIds.insert(name, m_FlagIds.size());
+  }
+  return *iter;
+}
+
+int CompiledConditions::valueId(const QString &value)
+{
+  auto iter = m_ValueIds.find(value);
+  if (iter == m_ValueIds.end()) {
+    iter = m_ValueIds.insert(value, m_ValueIds.size());
+  }
+  return *iter;
+}
+
+CompiledConditions::FlagValueList CompiledConditions::internFlags(const ConditionFlagList &flags)
+{
+  FlagValueList result;
+  for (const ConditionFlag &flag : flags) {
+    if (!flag.m_Name.isEmpty()) {
+      FlagValue interned = { flagId(flag.m_Name), valueId(flag.m_Value) };
+      result.push_back(interned);
+    }
+  }
+  return result;
+}
+
+int CompiledConditions::add(const FomodDocument &document, const SubCondition &condition,
+                            const Session &session)
+{
+  Node node = simplify(document, condition, session);
+  m_EliminatedNodes += countNodes(document, condition) - countNodes(node);
+  sortByCost(node);
+
+  Program program;
+  program.flagTests = node.cost;
+  program.begin = static_cast<int>(m_Code.size());
+  generate(node);
+  program.end = static_cast<int>(m_Code.size());
+  m_Programs.push_back(program);
+  return static_cast<int>(m_Programs.size()) - 1;
+}
+
+CompiledConditions::Node CompiledConditions::simplify(const FomodDocument &document,
+                                                     const SubCondition &condition,
+                                                     const Session &session)
+{
+  Node::Type type = condition.m_Operator == OP_AND ? Node::NODE_AND : Node::NODE_OR;
+  //The value that decides the result on its own: false for AND, true for OR.
+  //The opposite value doesn't affect the result at all
+  bool deciding = condition.m_Operator != OP_AND;
+
+  Node result = constant(!deciding);
+  result.type = type;
+  for (int i = 0; i < condition.m_Count; ++i) {
+    Node node = simplify(document, document.condition(condition.m_First + i), session);
+    if (isConstant(node, deciding)) {
+      return constant(deciding);
+    } else if (isConstant(node, !deciding)) {
+      continue;
+    } else if (node.type == type) {
+      result.children.insert(result.children.end(), node.children.begin(), node.children.end());
+    } else {
+      result.children.push_back(node);
+    }
+  }
+
+  if (result.children.empty()) {
+    //Nothing matched (OR) or everything matched (AND)
+    return constant(!deciding);
+  } else if (result.children.size() == 1) {
+    return result.children.front();
+  } else {
+    return result;
+  }
+}
+
+CompiledConditions::Node CompiledConditions::simplify(const FomodDocument &document,
+                                                     const Condition &condition,
+                                                     const Session &session)
+{
+  switch (condition.m_Type) {
+    case Condition::TYPE_SUB: {
+      return simplify(document, condition.m_Sub, session);
+    } break;
+    case Condition::TYPE_FLAG: {
+      Node result = { Node::NODE_FLAG, flagId(document.string(condition.m_Name)),
+                      valueId(document.string(condition.m_Value)), std::vector<Node>(), 1 };
+      return result;
+    } break;
+    case Condition::TYPE_FILE: {
+      return constant(session.fileStates.value(document.string(condition.m_Name))
+                      == document.string(condition.m_Value));
+    } break;
+    case Condition::TYPE_VERSION: {
+      quint64 actual = 0;
+      QString actualString;
+      switch (condition.m_VersionType) {
+        case Condition::VERSION_GAME: {
+          actual = session.gameVersion;
+          actualString = session.gameVersionString;
+        } break;
+        case Condition::VERSION_FOMM: {
+          actual = Condition::FOMM_VERSION;
+          actualString = Condition::FOMM_VERSION_STRING;
+        } break;
+        case Condition::VERSION_FOSE: {
+          actual = session.extenderVersion;
+          actualString = session.extenderVersionString;
+        } break;
+      }
+      if ((condition.m_Version == Condition::UNPACKED_VERSION) || (actual == Condition::UNPACKED_VERSION)) {
+        return constant(Condition::versionLessEqual(document.string(condition.m_Name), actualString));
+      }
+      return constant(condition.m_Version <= actual);
+    } break;
+  }
+  qCritical("unsupported condition type");
+  return constant(false);
+}
+
+CompiledConditions::Node CompiledConditions::constant(bool value)
+{
+  Node result = { Node::NODE_CONST, value ? 1 : 0, 0, std::vector<Node>(), 0 };
+  return result;
+}
+
+bool CompiledConditions::isConstant(const Node &node, bool value)
+{
+  return (node.type == Node::NODE_CONST) && ((node.operand != 0) == value);
+}
+
+int CompiledConditions::countNodes(const FomodDocument &document, const SubCondition &condition)
+{
+  int result = 1;
+  for (int i = 0; i < condition.m_Count; ++i) {
+    const Condition &child = document.condition(condition.m_First + i);
+    result += child.m_Type == Condition::TYPE_SUB ? countNodes(document, child.m_Sub) : 1;
+  }
+  return result;
+}
+
+int CompiledConditions::countNodes(const Node &node)
+{
+  int result = 1;
+  for (const Node &child : node.children) {
+    result += countNodes(child);
+  }
+  return result;
+}
+
+void CompiledConditions::sortByCost(Node &node)
+{
+  if (node.children.empty()) {
+    return;
+  }
+  node.cost = 0;
+  for (Node &child : node.children) {
+    sortByCost(child);
+    node.cost += child.cost;
+  }
+  //Conditions have no side effects so the order doesn't change the result. Operands
+  //of equal cost keep their order from the document
+  if (!std::is_sorted(node.children.begin(), node.children.end(),
+                      [] (const Node &lhs, const Node &rhs) { return lhs.cost < rhs.cost; })) {
+    std::stable_sort(node.children.begin(), node.children.end(),
+                     [] (const Node &lhs, const Node &rhs) { return lhs.cost < rhs.cost; });
+    ++m_ReorderedGroups;
+  }
+}
+
+void CompiledConditions::generate(const Node &node)
+{
+  switch (node.type) {
+    case Node::NODE_CONST: {
+      generate(OPCODE_CONST, node.operand);
+    } break;
+    case Node::NODE_FLAG: {
+      generate(OPCODE_FLAG, node.operand, node.value);
+    } break;
+    case Node::NODE_AND:
+    case Node::NODE_OR: {
+      //After each operand, skip to the end if the result is decided. The accumulator then
+      //holds the result of the whole expression
+      std::vector<size_t> jumps;
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        generate(node.children[i]);
+        if (i + 1 < node.children.size()) {
+          jumps.push_back(m_Code.size());
+          generate(node.type == Node::NODE_AND ? OPCODE_JUMP_FALSE : OPCODE_JUMP_TRUE, 0);
+        }
+      }
+      for (size_t jump : jumps) {
+        m_Code[jump].operand = static_cast<int>(m_Code.size());
+      }
+    } break;
+  }
+}
+
+void CompiledConditions::generate(OpCode opcode, int operand, int value)
+{
+  Instruction instruction = { opcode, operand, value };
+  m_Code.push_back(instruction);
+}
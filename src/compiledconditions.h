@@ -0,0 +1,251 @@
+#ifndef COMPILEDCONDITIONS_H
+#define COMPILEDCONDITIONS_H
+
+#include "fomoddocument.h"
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+/**
+ * @brief the conditions of a fomod lowered to flat instruction lists.
+ *
+ * Every top-level condition of a document (module dependencies, step visibility, dependency
+ * patterns and conditional installs) is compiled into a program of a few instructions that
+ * operate on a single boolean accumulator. "And" and "Or" are implemented as conditional
+ * jumps so evaluation short-circuits like the tree based evaluation did. Flag names and values
+ * are interned to integers so flag tests compare numbers instead of strings.
+ *
+ * Before code is generated each condition is simplified. File and version dependencies can't
+ * change while the dialog is open so they are replaced by their result, which is then folded
+ * into the surrounding operators. Nested groups with the same operator are flattened and
+ * groups with a single operand are replaced by that operand. Finally the operands of each
+ * group are ordered by their cost, the number of flag tests they contain, so cheap operands
+ * get a chance to decide the result before expensive ones are evaluated. As conditions have
+ * no side effects this doesn't change the result. What remains at runtime are flag tests,
+ * which are delegated to a tester object:
+ *   bool testFlag(int maxIndex, int flag, int value) const;
+ */
+class CompiledConditions
+{
+public:
+
+  enum OpCode {
+    OPCODE_CONST,       // accumulator = operand != 0
+    OPCODE_FLAG,        // accumulator = flag <operand> has value <value>
+    OPCODE_JUMP_FALSE,  // continue at <operand> if the accumulator is false
+    OPCODE_JUMP_TRUE    // continue at <operand> if the accumulator is true
+  };
+
+  struct Instruction {
+    OpCode opcode;
+    int operand;
+    int value;
+  };
+
+  // the values file and version dependencies are tested against
+  struct Session {
+    Session() : gameVersion(0), extenderVersion(0) {}
+    // packed, see Condition::packVersion
+    quint64 gameVersion;
+    quint64 extenderVersion;
+    // as reported, for versions that can't be packed
+    QString gameVersionString;
+    QString extenderVersionString;
+    // state name (Active, Inactive or Missing) by file name
+    QHash<QString, QString> fileStates;
+  };
+
+  // a flag with a value, both interned
+  struct FlagValue {
+    int flag;
+    int value;
+  };
+
+  typedef std::vector<FlagValue> FlagValueList;
+
+  // counters collected while evaluating
+  struct Statistics {
+    Statistics() : evaluations(0), flagTests(0), shortCircuitedTests(0) {}
+    int evaluations;
+    int flagTests;
+    // flag tests that weren't needed because the result was already decided. This
+    // includes those that document order would have skipped as well
+    int shortCircuitedTests;
+  };
+
+  // id of the empty value, which is what unset flags have
+  static const int EMPTY_VALUE = 0;
+
+public:
+
+  CompiledConditions();
+
+  /**
+   * @return all files tested by file dependencies in the document, without duplicates
+   */
+  static QStringList fileDependencies(const FomodDocument &document);
+
+  /**
+   * @brief compile all conditions of the document. The m_Index of each top-level condition
+   *        is set to the program compiled from it. Compiling again, for example after the
+   *        session changed, replaces all programs but keeps the ids of interned flags
+   */
+  void compile(FomodDocument &document, const Session &session);
+
+  /**
+   * @brief evaluate a compiled condition
+   * @param index the m_Index of the condition
+   * @param maxIndex passed on to the flag tests
+   */
+  template <typename Tester>
+  bool evaluate(int index, int maxIndex, const Tester &tester) const;
+
+  /**
+   * @return the ids of all flags tested by a compiled condition, without duplicates
+   */
+  std::vector<int> flags(int index) const;
+
+  /**
+   * @return the id of a flag name
+   */
+  int flagId(const QString &name);
+
+  /**
+   * @return the id of a flag value
+   */
+  int valueId(const QString &value);
+
+  /**
+   * @return the interned form of the condition flags set by a plugin
+   */
+  FlagValueList internFlags(const ConditionFlagList &flags);
+
+  /**
+   * @return total number of instructions in all programs
+   */
+  size_t size() const { return m_Code.size(); }
+
+  /**
+   * @return number of condition nodes removed by simplification in the last compile
+   */
+  int eliminatedNodes() const { return m_EliminatedNodes; }
+
+  /**
+   * @return number of groups whose operands were reordered in the last compile
+   */
+  int reorderedGroups() const { return m_ReorderedGroups; }
+
+  /**
+   * @return number of dependency patterns that can never apply after the last compile
+   */
+  int deadPatterns() const { return m_DeadPatterns; }
+
+  /**
+   * @return number of conditional installs that can never apply after the last compile
+   */
+  int deadInstalls() const { return m_DeadInstalls; }
+
+  /**
+   * @return counters for all evaluations since the last compile
+   */
+  const Statistics &statistics() const { return m_Statistics; }
+
+private:
+
+  struct Program {
+    int begin;
+    int end;
+    int flagTests;
+  };
+
+  // a condition after simplification
+  struct Node {
+    enum Type {
+      NODE_CONST,
+      NODE_FLAG,
+      NODE_AND,
+      NODE_OR
+    };
+
+    Type type;
+    // the constant for NODE_CONST, the flag for NODE_FLAG
+    int operand;
+    int value;
+    std::vector<Node> children;
+    // number of flag tests in this node and its children
+    int cost;
+  };
+
+private:
+
+  int add(const FomodDocument &document, const SubCondition &condition, const Session &session);
+  bool isConstant(int index, bool value) const;
+
+  Node simplify(const FomodDocument &document, const SubCondition &condition, const Session &session);
+  Node simplify(const FomodDocument &document, const Condition &condition, const Session &session);
+  static Node constant(bool value);
+  static bool isConstant(const Node &node, bool value);
+  static int countNodes(const FomodDocument &document, const SubCondition &condition);
+  static int countNodes(const Node &node);
+  void sortByCost(Node &node);
+
+  void generate(const Node &node);
+  void generate(OpCode opcode, int operand, int value = 0);
+
+private:
+
+  std::vector<Instruction> m_Code;
+  std::vector<Program> m_Programs;
+
+  QHash<QString, int> m_FlagIds;
+  QHash<QString, int> m_ValueIds;
+
+  int m_EliminatedNodes;
+  int m_ReorderedGroups;
+  int m_DeadPatterns;
+  int m_DeadInstalls;
+  mutable Statistics m_Statistics;
+
+};
+
+
+template <typename Tester>
+bool CompiledConditions::evaluate(int index, int maxIndex, const Tester &tester) const
+{
+  const Program &program = m_Programs[index];
+  const Instruction *code = m_Code.data();
+  bool accumulator = true;
+  int flagTests = 0;
+  int pc = program.begin;
+  while (pc < program.end) {
+    const Instruction &instruction = code[pc++];
+    switch (instruction.opcode) {
+      case OPCODE_CONST: {
+        accumulator = instruction.operand != 0;
+      } break;
+      case OPCODE_FLAG: {
+        accumulator = tester.testFlag(maxIndex, instruction.operand, instruction.value);
+        ++flagTests;
+      } break;
+      case OPCODE_JUMP_FALSE: {
+        if (!accumulator) {
+          pc = instruction.operand;
+        }
+      } break;
+      case OPCODE_JUMP_TRUE: {
+        if (accumulator) {
+          pc = instruction.operand;
+        }
+      } break;
+    }
+  }
+  ++m_Statistics.evaluations;
+  m_Statistics.flagTests += flagTests;
+  m_Statistics.shortCircuitedTests += program.flagTests - flagTests;
+  return accumulator;
+}
+
+#endif // COMPILEDCONDITIONS_H
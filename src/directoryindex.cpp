@@ -0,0 +1,153 @@
+#include "directoryindex.h"
+
+#include <QStringList>
+
+using namespace MOBase;
+
+
+DirectoryIndex::DirectoryIndex(DirectoryTree::Node *root)
+  : m_Root(root)
+{
+  addChildren(root, QString());
+}
+
+DirectoryTree::Node *DirectoryIndex::find(const QString &path, const QString &key, bool create)
+{
+  if (path.isEmpty()) {
+    return m_Root;
+  }
+
+  auto iter = m_Nodes.find(key);
+  if (iter != m_Nodes.end()) {
+    return *iter;
+  }
+
+  //Start at the deepest directory on the path that is known already
+  DirectoryTree::Node *node = m_Root;
+  int start = 0;
+  for (int pos = path.lastIndexOf('/'); pos > 0; pos = path.lastIndexOf('/', pos - 1)) {
+    iter = m_Nodes.find(DirectoryIndex::key(path.left(pos)));
+    if (iter != m_Nodes.end()) {
+      node = *iter;
+      start = pos + 1;
+      break;
+    }
+  }
+
+  while (start < path.size()) {
+    int end = path.indexOf('/', start);
+    if (end == -1) {
+      end = path.size();
+    }
+    QString name = path.mid(start, end - start);
+
+    DirectoryTree::Node *next = child(node, name);
+    if (next == nullptr) {
+      if (!create) {
+        return nullptr;
+      }
+      next = new DirectoryTree::Node;
+      next->setData(name);
+      node->addNode(next, false);
+    }
+
+    QString nextKey = DirectoryIndex::key(path.left(end));
+    m_Nodes.insert(nextKey, next);
+    //Moved nodes aren't in the index yet
+    addChildren(next, nextKey);
+    node = next;
+    start = end + 1;
+  }
+  return node;
+}
+
+void DirectoryIndex::invalidate(const QString &key)
+{
+  if (key.isEmpty()) {
+    m_Nodes.clear();
+    m_Files.clear();
+    return;
+  }
+
+  //The keys below the directory all start with the same prefix so they are adjacent
+  //in the map, only those are visited
+  QString prefix = key + "/";
+  auto iter = m_Nodes.lowerBound(prefix);
+  while ((iter != m_Nodes.end()) && iter.key().startsWith(prefix)) {
+    m_Files.remove(iter.value());
+    iter = m_Nodes.erase(iter);
+  }
+}
+
+void DirectoryIndex::addChildren(DirectoryTree::Node *node, const QString &key)
+{
+  for (DirectoryTree::const_node_iterator iter = node->nodesBegin(); iter != node->nodesEnd(); ++iter) {
+    QString name = (*iter)->getData().name;
+    QString childKey = key.isEmpty() ? name.toCaseFolded() : key + "/" + name.toCaseFolded();
+    //Like a search of the children, the first node with a name wins
+    if (!m_Nodes.contains(childKey)) {
+      m_Nodes.insert(childKey, *iter);
+      addChildren(*iter, childKey);
+    }
+  }
+}
+
+const std::vector<const FileTreeInformation*> &DirectoryIndex::files(DirectoryTree::Node *node,
+                                                                    const QString &key)
+{
+  static const std::vector<const FileTreeInformation*> noFiles;
+
+  auto nodeIter = m_Files.find(node);
+  if (nodeIter == m_Files.end()) {
+    nodeIter = m_Files.insert(node, FileMap());
+    //In the same order a reverse search through the files would find them
+    for (DirectoryTree::const_leaf_reverse_iterator iter = node->leafsRBegin(); iter != node->leafsREnd(); ++iter) {
+      QString name = iter->getName();
+      (*nodeIter)[name.toCaseFolded()].push_back(&*iter);
+    }
+  }
+
+  auto iter = nodeIter->find(key);
+  return iter != nodeIter->end() ? *iter : noFiles;
+}
+
+DirectoryTree::Node *DirectoryIndex::search(DirectoryTree::Node *root, const QString &path)
+{
+  DirectoryTree::Node *node = root;
+  for (const QString &name : normalize(path).split('/', QString::SkipEmptyParts)) {
+    node = child(node, name);
+    if (node == nullptr) {
+      break;
+    }
+  }
+  return node;
+}
+
+DirectoryTree::Node *DirectoryIndex::child(DirectoryTree::Node *node, const QString &name)
+{
+  for (DirectoryTree::const_node_iterator iter = node->nodesBegin(); iter != node->nodesEnd(); ++iter) {
+    if ((*iter)->getData().name == name) {
+      return *iter;
+    }
+  }
+  return nullptr;
+}
+
+QString DirectoryIndex::normalize(const QString &path)
+{
+  QString result;
+  result.reserve(path.size());
+  for (QChar ch : path) {
+    if ((ch == '\\') || (ch == '/')) {
+      if (!result.isEmpty() && !result.endsWith('/')) {
+        result.append('/');
+      }
+    } else {
+      result.append(ch);
+    }
+  }
+  if (result.endsWith('/')) {
+    result.chop(1);
+  }
+  return result;
+}
@@ -0,0 +1,86 @@
+#ifndef DIRECTORYINDEX_H
+#define DIRECTORYINDEX_H
+
+#include "directorytree.h"
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+#include <vector>
+
+/**
+ * @brief maps directory paths to the nodes of a DirectoryTree.
+ *
+ * Paths are relative to the root of the tree, normalized with normalize() and compared
+ * case-insensitively like the names of the nodes themselves. All directories
+ * existing when the index is created are added right away, directories created through
+ * the index or reached by walking the tree after a miss are added as they are found, so
+ * a path that has been seen before resolves with a single lookup. Directories are kept
+ * ordered by path so invalidating one only visits the directories below it.
+ */
+class DirectoryIndex
+{
+public:
+
+  explicit DirectoryIndex(MOBase::DirectoryTree::Node *root);
+
+  /**
+   * @brief look up a directory
+   * @param path the directory, normalized as by normalize()
+   * @param key the path case folded, as returned by key()
+   * @param create if set, missing directories are added to the tree
+   * @return the node or a null pointer if it doesn't exist and create isn't set
+   */
+  MOBase::DirectoryTree::Node *find(const QString &path, const QString &key, bool create);
+
+  /**
+   * @brief forget all directories below the specified one. Has to be called before nodes
+   *        below it are moved or deleted. The directory itself stays valid
+   * @param key the directory as returned by key()
+   */
+  void invalidate(const QString &key);
+
+  /**
+   * @brief look up the files with a name in a directory. The files of a directory are indexed
+   *        the first time any of them is requested, they are assumed not to change afterwards
+   * @param node a directory returned by find()
+   * @param key the file name case folded
+   * @return the matching files in the reverse of the order they are stored in
+   */
+  const std::vector<const MOBase::FileTreeInformation*> &files(MOBase::DirectoryTree::Node *node,
+                                                               const QString &key);
+
+  /**
+   * @brief look up a directory by walking the tree, without an index
+   * @return the node or a null pointer if it doesn't exist
+   */
+  static MOBase::DirectoryTree::Node *search(MOBase::DirectoryTree::Node *root, const QString &path);
+
+  /**
+   * @return the path with separators unified to '/' and empty components removed
+   */
+  static QString normalize(const QString &path);
+
+  /**
+   * @return the form of a normalized path used for lookups
+   */
+  static QString key(const QString &path) { return path.toCaseFolded(); }
+
+private:
+
+  void addChildren(MOBase::DirectoryTree::Node *node, const QString &key);
+
+  static MOBase::DirectoryTree::Node *child(MOBase::DirectoryTree::Node *node, const QString &name);
+
+private:
+
+  typedef QHash<QString, std::vector<const MOBase::FileTreeInformation*>> FileMap;
+
+  MOBase::DirectoryTree::Node *m_Root;
+  QMap<QString, MOBase::DirectoryTree::Node*> m_Nodes;
+  QHash<const MOBase::DirectoryTree::Node*, FileMap> m_Files;
+
+};
+
+#endif // DIRECTORYINDEX_H
@@ -0,0 +1,306 @@
+#include "encodingsniffer.h"
+
+#include <QTextCodec>
+#include <QtEndian>
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define ENCODINGSNIFFER_SSE2
+#endif
+
+
+namespace {
+
+// codec mib numbers as assigned by IANA
+const int MIB_UTF8 = 106;
+const int MIB_UTF16BE = 1013;
+const int MIB_UTF16LE = 1014;
+const int MIB_UTF16 = 1015;
+const int MIB_UTF32BE = 1018;
+const int MIB_UTF32LE = 1019;
+const int MIB_UTF32 = 1017;
+
+// the longest xml declaration we bother looking at
+const int MAX_DECLARATION_LENGTH = 512;
+
+std::uint64_t load64(const unsigned char *data)
+{
+  std::uint64_t result;
+  memcpy(&result, data, sizeof(result));
+  return result;
+}
+
+// a byte with this value in every byte of a 64 bit word
+std::uint64_t broadcast(unsigned char value)
+{
+  return 0x0101010101010101ULL * value;
+}
+
+// number of bytes at the start of the buffer that are plain ascii. This is only used to
+// skip ahead quickly so it may stop early but never reports a non-ascii byte as ascii
+std::size_t asciiPrefix(const unsigned char *data, std::size_t size)
+{
+  std::size_t pos = 0;
+#ifdef ENCODINGSNIFFER_SSE2
+  for (; pos + 16 <= size; pos += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    if (_mm_movemask_epi8(chunk) != 0) {
+      break;
+    }
+  }
+#endif
+  for (; pos + 8 <= size; pos += 8) {
+    if ((load64(data + pos) & broadcast(0x80)) != 0) {
+      break;
+    }
+  }
+  return pos;
+}
+
+}
+
+
+EncodingSniffer::EncodingSniffer(const char *data, std::size_t size)
+  : m_Data(data), m_Size(size), m_Encoding(ENCODING_UTF8), m_BOMSize(0), m_DeclarationMatches(true)
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+
+  bool utf16 = false;
+  bool bigEndian = false;
+  if ((size >= 3) && (bytes[0] == 0xEF) && (bytes[1] == 0xBB) && (bytes[2] == 0xBF)) {
+    m_BOMSize = 3;
+  } else if ((size >= 2) && (bytes[0] == 0xFF) && (bytes[1] == 0xFE)) {
+    utf16 = true;
+    m_BOMSize = 2;
+  } else if ((size >= 2) && (bytes[0] == 0xFE) && (bytes[1] == 0xFF)) {
+    utf16 = true;
+    bigEndian = true;
+    m_BOMSize = 2;
+  } else if ((size >= 2) && (bytes[0] == '<') && (bytes[1] == 0x00)) {
+    utf16 = true;
+  } else if ((size >= 2) && (bytes[0] == 0x00) && (bytes[1] == '<')) {
+    utf16 = true;
+    bigEndian = true;
+  }
+
+  const char *content = data + m_BOMSize;
+  std::size_t contentSize = size - m_BOMSize;
+  if (utf16 && isValidUtf16(content, contentSize, bigEndian)) {
+    m_Encoding = bigEndian ? ENCODING_UTF16BE : ENCODING_UTF16LE;
+  } else if (isValidUtf8(content, contentSize)) {
+    m_Encoding = ENCODING_UTF8;
+  } else {
+    m_Encoding = ENCODING_LATIN1;
+  }
+
+  readDeclaration();
+  m_DeclarationMatches = checkDeclaration();
+}
+
+const char *EncodingSniffer::codecName() const
+{
+  switch (m_Encoding) {
+    case ENCODING_UTF16LE: return "UTF-16LE";
+    case ENCODING_UTF16BE: return "UTF-16BE";
+    case ENCODING_LATIN1:  return "ISO-8859-1";
+    default:               return "UTF-8";
+  }
+}
+
+void EncodingSniffer::readDeclaration()
+{
+  // the declaration consists of ascii characters only so for utf-16 we only
+  // need to look at every other byte
+  bool utf16 = (m_Encoding == ENCODING_UTF16LE) || (m_Encoding == ENCODING_UTF16BE);
+  std::size_t step = utf16 ? 2 : 1;
+  std::size_t lowOffset = (m_Encoding == ENCODING_UTF16BE) ? 1 : 0;
+
+  QByteArray declaration;
+  for (std::size_t pos = m_BOMSize;
+       (pos + step <= m_Size) && (declaration.size() < MAX_DECLARATION_LENGTH); pos += step) {
+    if (utf16 && (m_Data[pos + 1 - lowOffset] != '\0')) {
+      break;
+    }
+    char ch = m_Data[pos + lowOffset];
+    declaration.append(ch);
+    if (ch == '>') {
+      break;
+    }
+  }
+
+  if (!declaration.startsWith("<?xml") || !declaration.endsWith("?>")) {
+    return;
+  }
+
+  int pos = declaration.indexOf("encoding");
+  if (pos == -1) {
+    return;
+  }
+  pos += 8;
+  while ((pos < declaration.size()) && isspace(static_cast<unsigned char>(declaration.at(pos)))) {
+    ++pos;
+  }
+  if ((pos >= declaration.size()) || (declaration.at(pos) != '=')) {
+    return;
+  }
+  ++pos;
+  while ((pos < declaration.size()) && isspace(static_cast<unsigned char>(declaration.at(pos)))) {
+    ++pos;
+  }
+  if ((pos >= declaration.size()) || ((declaration.at(pos) != '"') && (declaration.at(pos) != '\''))) {
+    return;
+  }
+  int end = declaration.indexOf(declaration.at(pos), pos + 1);
+  if (end != -1) {
+    m_DeclaredEncoding = declaration.mid(pos + 1, end - pos - 1);
+  }
+}
+
+bool EncodingSniffer::checkDeclaration() const
+{
+  if (m_DeclaredEncoding.isEmpty()) {
+    // without a declaration qt detects utf-8 and utf-16 on its own but assumes
+    // utf-8 for anything else
+    return m_Encoding != ENCODING_LATIN1;
+  }
+
+  QTextCodec *codec = QTextCodec::codecForName(m_DeclaredEncoding);
+  if (codec == nullptr) {
+    return false;
+  }
+
+  int mib = codec->mibEnum();
+  bool declaredUtf16 = (mib == MIB_UTF16) || (mib == MIB_UTF16LE) || (mib == MIB_UTF16BE);
+  bool contentUtf16 = (m_Encoding == ENCODING_UTF16LE) || (m_Encoding == ENCODING_UTF16BE);
+  if (declaredUtf16 || contentUtf16) {
+    return declaredUtf16 == contentUtf16;
+  } else if ((mib == MIB_UTF32) || (mib == MIB_UTF32LE) || (mib == MIB_UTF32BE)) {
+    return false;
+  } else if (mib == MIB_UTF8) {
+    return m_Encoding == ENCODING_UTF8;
+  } else {
+    // 8-bit codepages accept any byte
+    return true;
+  }
+}
+
+QString EncodingSniffer::decode() const
+{
+  QTextCodec *codec = QTextCodec::codecForName(codecName());
+  QString result = codec->toUnicode(m_Data + m_BOMSize, static_cast<int>(m_Size - m_BOMSize));
+  if (result.startsWith(QChar(QChar::ByteOrderMark))) {
+    result.remove(0, 1);
+  }
+  if (result.startsWith(QLatin1String("<?xml"))) {
+    int end = result.indexOf(QLatin1String("?>"));
+    if (end != -1) {
+      result.remove(0, end + 2);
+    }
+  }
+  return result;
+}
+
+bool EncodingSniffer::isValidUtf8(const char *data, std::size_t size)
+{
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+  std::size_t pos = 0;
+  while (pos < size) {
+    pos += asciiPrefix(bytes + pos, size - pos);
+    if (pos >= size) {
+      break;
+    }
+
+    unsigned char lead = bytes[pos];
+    std::size_t length;
+    std::uint32_t codePoint;
+    std::uint32_t minimum;
+    if (lead < 0x80) {
+      ++pos;
+      continue;
+    } else if ((lead & 0xE0) == 0xC0) {
+      length = 2;
+      codePoint = lead & 0x1F;
+      minimum = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+      length = 3;
+      codePoint = lead & 0x0F;
+      minimum = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+      length = 4;
+      codePoint = lead & 0x07;
+      minimum = 0x10000;
+    } else {
+      return false;
+    }
+
+    if (size - pos < length) {
+      return false;
+    }
+    for (std::size_t i = 1; i < length; ++i) {
+      unsigned char continuation = bytes[pos + i];
+      if ((continuation & 0xC0) != 0x80) {
+        return false;
+      }
+      codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+    // reject overlong encodings, surrogates and values beyond the unicode range
+    if ((codePoint < minimum) || (codePoint > 0x10FFFF)
+        || ((codePoint >= 0xD800) && (codePoint <= 0xDFFF))) {
+      return false;
+    }
+    pos += length;
+  }
+  return true;
+}
+
+bool EncodingSniffer::isValidUtf16(const char *data, std::size_t size, bool bigEndian)
+{
+  if ((size % 2) != 0) {
+    return false;
+  }
+
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+  std::size_t highOffset = bigEndian ? 0 : 1;
+
+  // when loading 8 bytes into a word, select the bytes holding the high half of each code unit.
+  // A surrogate is a unit whose high byte is in the range 0xD8-0xDF
+  std::uint64_t highMask = (bigEndian == (Q_BYTE_ORDER == Q_BIG_ENDIAN)) ? 0xFF00FF00FF00FF00ULL
+                                                                         : 0x00FF00FF00FF00FFULL;
+  std::uint64_t lowOnes = ~highMask & broadcast(0x01);
+
+  std::size_t pos = 0;
+  while (pos < size) {
+    // skip over chunks of 4 code units without surrogates
+    for (; pos + 8 <= size; pos += 8) {
+      // low bytes are set to 1, high bytes become 0 exactly for surrogates
+      std::uint64_t word = ((load64(bytes + pos) & broadcast(0xF8) & highMask) ^ (broadcast(0xD8) & highMask)) | lowOnes;
+      if (((word - broadcast(0x01)) & ~word & broadcast(0x80)) != 0) {
+        break;
+      }
+    }
+    if (pos >= size) {
+      break;
+    }
+
+    unsigned int unit = (bytes[pos + highOffset] << 8) | bytes[pos + 1 - highOffset];
+    if ((unit >= 0xD800) && (unit <= 0xDBFF)) {
+      if (pos + 4 > size) {
+        return false;
+      }
+      unsigned int next = (bytes[pos + 2 + highOffset] << 8) | bytes[pos + 3 - highOffset];
+      if ((next < 0xDC00) || (next > 0xDFFF)) {
+        return false;
+      }
+      pos += 4;
+    } else if ((unit >= 0xDC00) && (unit <= 0xDFFF)) {
+      return false;
+    } else {
+      pos += 2;
+    }
+  }
+  return true;
+}
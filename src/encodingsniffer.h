@@ -0,0 +1,78 @@
+#ifndef ENCODINGSNIFFER_H
+#define ENCODINGSNIFFER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+
+/**
+ * @brief determines the actual encoding of an xml document from its raw bytes.
+ *
+ * Plenty of fomods declare an encoding in their xml header that doesn't match the content.
+ * Qt's xml parser rejects those whereas nmm's parser doesn't care. This inspects the bytes
+ * once so the document can be parsed a single time, either as is or after decoding it with
+ * the encoding the content actually has.
+ */
+class EncodingSniffer
+{
+public:
+
+  enum Encoding {
+    ENCODING_UTF8,
+    ENCODING_UTF16LE,
+    ENCODING_UTF16BE,
+    ENCODING_LATIN1
+  };
+
+public:
+
+  EncodingSniffer(const char *data, std::size_t size);
+
+  /**
+   * @return the encoding of the content
+   */
+  Encoding encoding() const { return m_Encoding; }
+
+  /**
+   * @return name of the codec for the encoding of the content
+   */
+  const char *codecName() const;
+
+  /**
+   * @return the encoding named in the xml declaration or an empty string if there is none
+   */
+  const QByteArray &declaredEncoding() const { return m_DeclaredEncoding; }
+
+  /**
+   * @return true if the raw document can be handed to the xml parser as is, that is if the
+   *         declared encoding (if any) is supported and matches the content
+   */
+  bool declarationMatches() const { return m_DeclarationMatches; }
+
+  /**
+   * @brief decode the document with the detected encoding. The byte order mark and xml
+   *        declaration are removed so the parser doesn't trip over a wrong encoding name
+   */
+  QString decode() const;
+
+  static bool isValidUtf8(const char *data, std::size_t size);
+  static bool isValidUtf16(const char *data, std::size_t size, bool bigEndian);
+
+private:
+
+  void readDeclaration();
+  bool checkDeclaration() const;
+
+private:
+
+  const char *m_Data;
+  std::size_t m_Size;
+  Encoding m_Encoding;
+  std::size_t m_BOMSize;
+  QByteArray m_DeclaredEncoding;
+  bool m_DeclarationMatches;
+
+};
+
+#endif // ENCODINGSNIFFER_H
@@ -0,0 +1,111 @@
+#include "flagstate.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+
+FlagState::FlagState()
+{
+}
+
+void FlagState::clear()
+{
+  m_Stacks.clear();
+  m_Pages.clear();
+  m_Changed.clear();
+}
+
+void FlagState::enterPage(int page, const CompiledConditions::FlagValueList &flags)
+{
+  Q_ASSERT(m_Pages.empty() || (m_Pages.back().index < page));
+  Page newPage = { page, flags };
+  push(newPage);
+  changed(flags);
+}
+
+void FlagState::updatePage(int page, const CompiledConditions::FlagValueList &flags)
+{
+  if (m_Pages.empty() || (m_Pages.back().index != page)) {
+    return;
+  }
+  //Only flags that were added, removed or set to a different value have changed
+  const CompiledConditions::FlagValueList &oldFlags = m_Pages.back().flags;
+  for (const CompiledConditions::FlagValue &flag : oldFlags) {
+    auto iter = std::find_if(flags.begin(), flags.end(),
+                             [&flag] (const CompiledConditions::FlagValue &newFlag) {
+                               return newFlag.flag == flag.flag;
+                             });
+    if ((iter == flags.end()) || (iter->value != flag.value)) {
+      m_Changed.push_back(flag.flag);
+    }
+  }
+  for (const CompiledConditions::FlagValue &flag : flags) {
+    auto iter = std::find_if(oldFlags.begin(), oldFlags.end(),
+                             [&flag] (const CompiledConditions::FlagValue &oldFlag) {
+                               return oldFlag.flag == flag.flag;
+                             });
+    if (iter == oldFlags.end()) {
+      m_Changed.push_back(flag.flag);
+    }
+  }
+  pop();
+  Page newPage = { page, flags };
+  push(newPage);
+}
+
+void FlagState::leavePages(int page)
+{
+  while (!m_Pages.empty() && (m_Pages.back().index >= page)) {
+    changed(m_Pages.back().flags);
+    pop();
+  }
+}
+
+int FlagState::value(int flag, int maxIndex) const
+{
+  if (flag >= static_cast<int>(m_Stacks.size())) {
+    return CompiledConditions::EMPTY_VALUE;
+  }
+  const std::vector<Entry> &stack = m_Stacks[flag];
+  for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
+    if (iter->page < maxIndex) {
+      return iter->value;
+    }
+  }
+  return CompiledConditions::EMPTY_VALUE;
+}
+
+std::vector<int> FlagState::takeChangedFlags()
+{
+  std::vector<int> result;
+  result.swap(m_Changed);
+  return result;
+}
+
+void FlagState::push(const Page &page)
+{
+  for (const CompiledConditions::FlagValue &flag : page.flags) {
+    if (flag.flag >= static_cast<int>(m_Stacks.size())) {
+      m_Stacks.resize(flag.flag + 1);
+    }
+    Entry entry = { page.index, flag.value };
+    m_Stacks[flag.flag].push_back(entry);
+  }
+  m_Pages.push_back(page);
+}
+
+void FlagState::pop()
+{
+  for (const CompiledConditions::FlagValue &flag : m_Pages.back().flags) {
+    m_Stacks[flag.flag].pop_back();
+  }
+  m_Pages.pop_back();
+}
+
+void FlagState::changed(const CompiledConditions::FlagValueList &flags)
+{
+  for (const CompiledConditions::FlagValue &flag : flags) {
+    m_Changed.push_back(flag.flag);
+  }
+}
@@ -0,0 +1,87 @@
+#ifndef FLAGSTATE_H
+#define FLAGSTATE_H
+
+#include "compiledconditions.h"
+
+#include <vector>
+
+/**
+ * @brief the value of every condition flag as set by the pages the user went through.
+ *
+ * Each page that has been entered contributes the flags set by its checked plugins. For each
+ * flag there is a stack of (page, value) entries ordered by page so the value effective before
+ * a given page is the topmost entry of an earlier page. Since only the current page can be on
+ * top of the requested one, a lookup is constant time.
+ *
+ * Pages have to be entered in ascending order. Going back leaves all pages from the one
+ * returned to onwards, toggling a plugin updates the contribution of the last page entered.
+ * Flags whose value may have changed are collected until they are retrieved with
+ * takeChangedFlags so dependent results can be invalidated.
+ */
+class FlagState
+{
+public:
+
+  FlagState();
+
+  /**
+   * @brief forget all pages
+   */
+  void clear();
+
+  /**
+   * @brief add the contribution of a page. The page has to come after all pages entered so far
+   * @param flags flags set by the page, each flag at most once
+   */
+  void enterPage(int page, const CompiledConditions::FlagValueList &flags);
+
+  /**
+   * @brief replace the contribution of a page. Does nothing unless the page is the last one
+   *        entered
+   */
+  void updatePage(int page, const CompiledConditions::FlagValueList &flags);
+
+  /**
+   * @brief remove the contributions of the specified page and all pages after it
+   */
+  void leavePages(int page);
+
+  /**
+   * @param flag interned flag name
+   * @param maxIndex only pages before this one are considered
+   * @return the interned value of the flag, EMPTY_VALUE if no page sets it
+   */
+  int value(int flag, int maxIndex) const;
+
+  /**
+   * @return the flags whose value may have changed since the last call
+   */
+  std::vector<int> takeChangedFlags();
+
+private:
+
+  struct Entry {
+    int page;
+    int value;
+  };
+
+  struct Page {
+    int index;
+    CompiledConditions::FlagValueList flags;
+  };
+
+private:
+
+  void push(const Page &page);
+  void pop();
+  void changed(const CompiledConditions::FlagValueList &flags);
+
+private:
+
+  std::vector<std::vector<Entry>> m_Stacks;
+  std::vector<Page> m_Pages;
+  std::vector<int> m_Changed;
+
+};
+
+#endif // FLAGSTATE_H
@@ -0,0 +1,516 @@
+#include "fomodcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <limits>
+#include <stdexcept>
+
+
+namespace {
+
+// "FMDC"
+const quint32 CACHE_MAGIC = 0x464d4443;
+
+// increase this whenever the serialized layout of FomodDocument changes
+const quint32 CACHE_VERSION = 4;
+
+const int KEY_SIZE = 20;
+const int CHECKSUM_SIZE = 16;
+// magic, version, key, payload size, checksum
+const int HEADER_SIZE = 4 + 4 + KEY_SIZE + 4 + CHECKSUM_SIZE;
+
+struct CacheError : std::runtime_error {
+  CacheError(const char *message)
+    : std::runtime_error(message) {}
+};
+
+
+QByteArray checksum(const QByteArray &payload)
+{
+  return QCryptographicHash::hash(payload, QCryptographicHash::Md5);
+}
+
+
+class DocumentWriter {
+public:
+  DocumentWriter(QDataStream &stream)
+    : m_Stream(stream)
+  {}
+
+  void write(const FomodDocument &document)
+  {
+    const StringPool &strings = document.strings();
+    m_Stream << static_cast<quint32>(strings.size());
+    for (int i = 0; i < strings.size(); ++i) {
+      m_Stream << strings.at(i);
+    }
+
+    const std::deque<FileDescriptor> &descriptors = document.fileDescriptors();
+    m_Stream << static_cast<quint32>(descriptors.size());
+    for (const FileDescriptor &descriptor : descriptors) {
+      m_Indices.insert(&descriptor, static_cast<quint32>(m_Indices.size()));
+      m_Stream << static_cast<qint32>(descriptor.m_Source) << static_cast<qint32>(descriptor.m_Destination);
+      writePath(descriptor.m_SourcePath);
+      writePath(descriptor.m_DestinationPath);
+      m_Stream << static_cast<qint32>(descriptor.m_Priority) << descriptor.m_IsFolder
+               << descriptor.m_AlwaysInstall << descriptor.m_InstallIfUsable
+               << static_cast<qint32>(descriptor.m_FileSystemItemSequence);
+    }
+
+    // the packed version is recalculated when reading
+    const std::vector<Condition> &conditions = document.conditions();
+    m_Stream << static_cast<quint32>(conditions.size());
+    for (const Condition &condition : conditions) {
+      m_Stream << static_cast<qint32>(condition.m_Type) << static_cast<qint32>(condition.m_Name)
+               << static_cast<qint32>(condition.m_Value) << static_cast<qint32>(condition.m_VersionType);
+      writeSubCondition(condition.m_Sub);
+    }
+
+    m_Stream << document.m_ModuleName;
+    writeSubCondition(document.m_ModuleDependencies);
+    writeFiles(document.m_RequiredFiles);
+
+    m_Stream << static_cast<quint32>(document.m_Steps.size());
+    for (const InstallStep &step : document.m_Steps) {
+      m_Stream << step.m_Name;
+      writeSubCondition(step.m_Visible);
+      m_Stream << static_cast<quint32>(step.m_Groups.size());
+      for (const Group &group : step.m_Groups) {
+        m_Stream << group.m_Name << static_cast<qint32>(group.m_Type);
+        m_Stream << static_cast<quint32>(group.m_Plugins.size());
+        for (const Plugin &plugin : group.m_Plugins) {
+          writePlugin(plugin);
+        }
+      }
+    }
+
+    m_Stream << static_cast<quint32>(document.m_ConditionalInstalls.size());
+    for (const ConditionalInstall &install : document.m_ConditionalInstalls) {
+      writeSubCondition(install.m_Condition);
+      writeFiles(install.m_Files);
+    }
+  }
+
+private:
+
+  void writePlugin(const Plugin &plugin)
+  {
+    m_Stream << plugin.m_Name << plugin.m_Description << plugin.m_ImagePath;
+    m_Stream << static_cast<qint32>(plugin.m_PluginTypeInfo.m_DefaultType);
+    m_Stream << static_cast<quint32>(plugin.m_PluginTypeInfo.m_DependencyPatterns.size());
+    for (const DependencyPattern &pattern : plugin.m_PluginTypeInfo.m_DependencyPatterns) {
+      m_Stream << static_cast<qint32>(pattern.type);
+      writeSubCondition(pattern.condition);
+    }
+    m_Stream << static_cast<quint32>(plugin.m_ConditionFlags.size());
+    for (const ConditionFlag &flag : plugin.m_ConditionFlags) {
+      m_Stream << flag.m_Name << flag.m_Value;
+    }
+    writeFiles(plugin.m_Files);
+  }
+
+  void writeFiles(const FileDescriptorList &files)
+  {
+    m_Stream << static_cast<quint32>(files.size());
+    for (const FileDescriptor *file : files) {
+      m_Stream << m_Indices.value(file);
+    }
+  }
+
+  void writePath(const DescriptorPath &path)
+  {
+    m_Stream << static_cast<qint32>(path.m_Directory) << static_cast<qint32>(path.m_DirectoryKey)
+             << static_cast<qint32>(path.m_Name) << static_cast<qint32>(path.m_NameKey);
+  }
+
+  void writeSubCondition(const SubCondition &condition)
+  {
+    m_Stream << static_cast<qint32>(condition.m_Operator) << static_cast<qint32>(condition.m_First)
+             << static_cast<qint32>(condition.m_Count);
+  }
+
+private:
+
+  QDataStream &m_Stream;
+  QHash<const FileDescriptor*, quint32> m_Indices;
+
+};
+
+
+class DocumentReader {
+public:
+  DocumentReader(QDataStream &stream)
+    : m_Stream(stream), m_Document(nullptr), m_NumStrings(0), m_NumConditions(0)
+  {}
+
+  void read(FomodDocument &document)
+  {
+    m_Document = &document;
+
+    // strings were written in the order they were added to the pool so adding them
+    // again reproduces the same indices
+    m_NumStrings = static_cast<int>(readCount());
+    for (int i = 0; i < m_NumStrings; ++i) {
+      QString string;
+      m_Stream >> string;
+      checkStatus();
+      if (document.addString(string) != i) {
+        throw CacheError("duplicate string");
+      }
+    }
+
+    quint32 numDescriptors = readCount();
+    m_Descriptors.reserve(numDescriptors);
+    for (quint32 i = 0; i < numDescriptors; ++i) {
+      FileDescriptor *descriptor = document.createFileDescriptor();
+      descriptor->m_Source = readString();
+      descriptor->m_Destination = readString();
+      readPath(descriptor->m_SourcePath);
+      readPath(descriptor->m_DestinationPath);
+      qint32 priority;
+      qint32 sequence;
+      m_Stream >> priority >> descriptor->m_IsFolder
+               >> descriptor->m_AlwaysInstall >> descriptor->m_InstallIfUsable
+               >> sequence;
+      descriptor->m_Priority = priority;
+      descriptor->m_FileSystemItemSequence = sequence;
+      m_Descriptors.push_back(descriptor);
+    }
+
+    readConditions();
+
+    m_Stream >> document.m_ModuleName;
+    readSubCondition(document.m_ModuleDependencies);
+    readFiles(document.m_RequiredFiles);
+
+    document.m_Steps.resize(readCount());
+    for (InstallStep &step : document.m_Steps) {
+      m_Stream >> step.m_Name;
+      readSubCondition(step.m_Visible);
+      step.m_Groups.resize(readCount());
+      for (Group &group : step.m_Groups) {
+        m_Stream >> group.m_Name;
+        group.m_Type = static_cast<GroupType>(readEnum(TYPE_SELECTALL));
+        group.m_Plugins.resize(readCount());
+        for (Plugin &plugin : group.m_Plugins) {
+          readPlugin(plugin);
+        }
+      }
+    }
+
+    document.m_ConditionalInstalls.resize(readCount());
+    for (ConditionalInstall &install : document.m_ConditionalInstalls) {
+      readSubCondition(install.m_Condition);
+      readFiles(install.m_Files);
+    }
+
+    checkStatus();
+    if (!m_Stream.atEnd()) {
+      throw CacheError("trailing data");
+    }
+  }
+
+private:
+
+  void checkStatus()
+  {
+    if (m_Stream.status() != QDataStream::Ok) {
+      throw CacheError("truncated data");
+    }
+  }
+
+  quint32 readCount()
+  {
+    quint32 result;
+    m_Stream >> result;
+    checkStatus();
+    // every element takes up at least one byte so this protects against
+    // allocating huge amounts of memory for garbage counts
+    if (result > static_cast<quint64>(m_Stream.device()->bytesAvailable())) {
+      throw CacheError("invalid count");
+    }
+    return result;
+  }
+
+  qint32 readEnum(qint32 max)
+  {
+    qint32 result;
+    m_Stream >> result;
+    checkStatus();
+    if ((result < 0) || (result > max)) {
+      throw CacheError("invalid enum value");
+    }
+    return result;
+  }
+
+  void readPlugin(Plugin &plugin)
+  {
+    m_Stream >> plugin.m_Name >> plugin.m_Description >> plugin.m_ImagePath;
+    plugin.m_PluginTypeInfo.m_DefaultType = static_cast<PluginType>(readEnum(TYPE_COULDBEUSABLE));
+    plugin.m_PluginTypeInfo.m_DependencyPatterns.resize(readCount());
+    for (DependencyPattern &pattern : plugin.m_PluginTypeInfo.m_DependencyPatterns) {
+      pattern.type = static_cast<PluginType>(readEnum(TYPE_COULDBEUSABLE));
+      readSubCondition(pattern.condition);
+    }
+    plugin.m_ConditionFlags.resize(readCount());
+    for (ConditionFlag &flag : plugin.m_ConditionFlags) {
+      m_Stream >> flag.m_Name >> flag.m_Value;
+    }
+    readFiles(plugin.m_Files);
+  }
+
+  void readFiles(FileDescriptorList &files)
+  {
+    quint32 count = readCount();
+    files.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+      quint32 index;
+      m_Stream >> index;
+      checkStatus();
+      if (index >= m_Descriptors.size()) {
+        throw CacheError("invalid file index");
+      }
+      files.push_back(m_Descriptors[index]);
+    }
+  }
+
+  qint32 readString()
+  {
+    qint32 result;
+    m_Stream >> result;
+    checkStatus();
+    if ((result < 0) || (result >= m_NumStrings)) {
+      throw CacheError("invalid string index");
+    }
+    return result;
+  }
+
+  void readPath(DescriptorPath &path)
+  {
+    path.m_Directory = readString();
+    path.m_DirectoryKey = readString();
+    path.m_Name = readString();
+    path.m_NameKey = readString();
+  }
+
+  void readConditions()
+  {
+    quint32 count = readCount();
+    std::vector<Condition> conditions;
+    conditions.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+      Condition::Type type = static_cast<Condition::Type>(readEnum(Condition::TYPE_SUB));
+      qint32 name = readString();
+      qint32 value = readString();
+      Condition::VersionType versionType = static_cast<Condition::VersionType>(readEnum(Condition::VERSION_FOSE));
+      // operands are always stored before the condition containing them so
+      // there can't be any cycles
+      SubCondition sub;
+      readSubCondition(sub, i);
+      switch (type) {
+        case Condition::TYPE_FLAG: {
+          conditions.push_back(Condition::flag(name, value));
+        } break;
+        case Condition::TYPE_FILE: {
+          conditions.push_back(Condition::file(name, value));
+        } break;
+        case Condition::TYPE_VERSION: {
+          conditions.push_back(Condition::version(versionType, name, m_Document->string(name)));
+        } break;
+        case Condition::TYPE_SUB: {
+          conditions.push_back(Condition::sub(sub));
+        } break;
+      }
+    }
+    m_NumConditions = static_cast<qint64>(count);
+    m_Document->addConditions(conditions);
+  }
+
+  void readSubCondition(SubCondition &condition)
+  {
+    readSubCondition(condition, m_NumConditions);
+  }
+
+  void readSubCondition(SubCondition &condition, qint64 limit)
+  {
+    condition.m_Operator = static_cast<ConditionOperator>(readEnum(OP_OR));
+    qint32 first;
+    qint32 count;
+    m_Stream >> first >> count;
+    checkStatus();
+    if ((first < 0) || (count < 0) || (static_cast<qint64>(first) + count > limit)) {
+      throw CacheError("invalid condition range");
+    }
+    condition.m_First = first;
+    condition.m_Count = count;
+  }
+
+private:
+
+  QDataStream &m_Stream;
+  FomodDocument *m_Document;
+  int m_NumStrings;
+  qint64 m_NumConditions;
+  FileDescriptorList m_Descriptors;
+
+};
+
+}
+
+
+const int FomodCache::DEFAULT_MAX_ENTRIES;
+const qint64 FomodCache::DEFAULT_MAX_SIZE;
+
+FomodCache::FomodCache(const QString &directory, int maxEntries, qint64 maxSize)
+  : m_Directory(directory), m_MaxEntries(maxEntries), m_MaxSize(maxSize)
+{
+}
+
+QString FomodCache::defaultDirectory()
+{
+  return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/fomod";
+}
+
+QByteArray FomodCache::key(const QByteArray &data)
+{
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QString FomodCache::fileName(const QByteArray &key) const
+{
+  return m_Directory + "/" + QString::fromLatin1(key.toHex()) + ".bin";
+}
+
+std::unique_ptr<FomodDocument> FomodCache::load(const QByteArray &key) const
+{
+  QFile file(fileName(key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return nullptr;
+  }
+
+  qint64 size = file.size();
+  if ((size < HEADER_SIZE) || (size > std::numeric_limits<int>::max())) {
+    qWarning("invalid fomod cache file %s", qPrintable(file.fileName()));
+    return nullptr;
+  }
+
+  // the mapping is released when the file is closed
+  const char *data = reinterpret_cast<const char*>(file.map(0, size));
+  if (data == nullptr) {
+    return nullptr;
+  }
+
+  try {
+    QDataStream header(QByteArray::fromRawData(data, HEADER_SIZE));
+    header.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    quint32 version;
+    quint32 payloadSize;
+    header >> magic >> version;
+    if ((magic != CACHE_MAGIC) || (version != CACHE_VERSION)) {
+      throw CacheError("wrong format version");
+    }
+    QByteArray storedKey(KEY_SIZE, '\0');
+    QByteArray storedChecksum(CHECKSUM_SIZE, '\0');
+    header.readRawData(storedKey.data(), KEY_SIZE);
+    header >> payloadSize;
+    header.readRawData(storedChecksum.data(), CHECKSUM_SIZE);
+    if (header.status() != QDataStream::Ok) {
+      throw CacheError("truncated header");
+    }
+    if (storedKey != key) {
+      throw CacheError("key mismatch");
+    }
+    if (payloadSize != size - HEADER_SIZE) {
+      throw CacheError("size mismatch");
+    }
+
+    QByteArray payload = QByteArray::fromRawData(data + HEADER_SIZE, static_cast<int>(payloadSize));
+    if (checksum(payload) != storedChecksum) {
+      throw CacheError("checksum mismatch");
+    }
+
+    std::unique_ptr<FomodDocument> document(new FomodDocument);
+    QDataStream stream(payload);
+    stream.setVersion(QDataStream::Qt_5_0);
+    DocumentReader reader(stream);
+    reader.read(*document);
+    return document;
+  } catch (const CacheError &e) {
+    qDebug("ignoring fomod cache file %s: %s", qPrintable(file.fileName()), e.what());
+    return nullptr;
+  }
+}
+
+bool FomodCache::store(const QByteArray &key, const FomodDocument &document) const
+{
+  QByteArray payload;
+  {
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    try {
+      DocumentWriter writer(stream);
+      writer.write(document);
+    } catch (const CacheError &e) {
+      qWarning("failed to serialize fomod: %s", e.what());
+      return false;
+    }
+  }
+
+  if (!QDir().mkpath(m_Directory)) {
+    qWarning("failed to create fomod cache directory %s", qPrintable(m_Directory));
+    return false;
+  }
+
+  QSaveFile file(fileName(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qWarning("failed to write fomod cache file %s", qPrintable(file.fileName()));
+    return false;
+  }
+
+  QDataStream header(&file);
+  header.setVersion(QDataStream::Qt_5_0);
+  header << CACHE_MAGIC << CACHE_VERSION;
+  header.writeRawData(key.constData(), KEY_SIZE);
+  header << static_cast<quint32>(payload.size());
+  header.writeRawData(checksum(payload).constData(), CHECKSUM_SIZE);
+  header.writeRawData(payload.constData(), payload.size());
+
+  if (!file.commit()) {
+    return false;
+  }
+  prune(file.fileName());
+  return true;
+}
+
+void FomodCache::prune(const QString &keep) const
+{
+  QFileInfo kept(keep);
+  int count = 1;
+  qint64 totalSize = kept.size();
+  bool full = false;
+  // newest first, once an entry doesn't fit all older ones are removed as well
+  QFileInfoList entries = QDir(m_Directory).entryInfoList(QStringList("*.bin"), QDir::Files, QDir::Time);
+  for (const QFileInfo &entry : entries) {
+    if (entry == kept) {
+      continue;
+    }
+    full = full || (count >= m_MaxEntries) || (totalSize + entry.size() > m_MaxSize);
+    if (full) {
+      if (!QFile::remove(entry.absoluteFilePath())) {
+        qWarning("failed to remove fomod cache file %s", qPrintable(entry.absoluteFilePath()));
+      }
+    } else {
+      ++count;
+      totalSize += entry.size();
+    }
+  }
+}
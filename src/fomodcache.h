@@ -0,0 +1,74 @@
+#ifndef FOMODCACHE_H
+#define FOMODCACHE_H
+
+#include "fomoddocument.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <memory>
+
+/**
+ * @brief on-disk cache of parsed ModuleConfig.xml files. Entries are keyed by a hash of the
+ *        raw xml so a changed file never matches a stale entry. Each entry is a small header
+ *        (magic, format version, key, payload size and checksum) followed by the serialized
+ *        document. Entries are memory-mapped for reading; anything that fails validation is
+ *        treated as a cache miss. The number and total size of entries are limited, whenever an
+ *        entry is stored the oldest ones beyond the limits are removed.
+ */
+class FomodCache
+{
+public:
+
+  static const int DEFAULT_MAX_ENTRIES = 200;
+  static const qint64 DEFAULT_MAX_SIZE = 32 * 1024 * 1024;
+
+public:
+
+  /**
+   * @param directory the directory the cache files are stored in. Created on demand
+   * @param maxEntries the number of entries to keep at most
+   * @param maxSize the total size in bytes of the entries to keep at most. The most recently
+   *                stored entry is kept even if it's larger
+   */
+  explicit FomodCache(const QString &directory, int maxEntries = DEFAULT_MAX_ENTRIES,
+                      qint64 maxSize = DEFAULT_MAX_SIZE);
+
+  /**
+   * @return the directory used if none is specified explicitly
+   */
+  static QString defaultDirectory();
+
+  /**
+   * @brief calculate the cache key for a ModuleConfig.xml
+   * @param data the raw content of the file
+   */
+  static QByteArray key(const QByteArray &data);
+
+  /**
+   * @brief look up a document
+   * @return the cached document or a null pointer if there is no valid entry for the key
+   */
+  std::unique_ptr<FomodDocument> load(const QByteArray &key) const;
+
+  /**
+   * @brief store a document, replacing any existing entry for the key. Entries exceeding the
+   *        limits of the cache are removed afterwards
+   * @return true on success
+   */
+  bool store(const QByteArray &key, const FomodDocument &document) const;
+
+private:
+
+  QString fileName(const QByteArray &key) const;
+  void prune(const QString &keep) const;
+
+private:
+
+  QString m_Directory;
+  int m_MaxEntries;
+  qint64 m_MaxSize;
+
+};
+
+#endif // FOMODCACHE_H
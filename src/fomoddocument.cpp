@@ -0,0 +1,163 @@
+#include "fomoddocument.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+
+static_assert(std::is_trivially_destructible<Condition>::value, "condition nodes are released in bulk");
+static_assert(std::is_trivially_destructible<FileDescriptor>::value, "file descriptors are released in bulk");
+
+
+const char Condition::FOMM_VERSION_STRING[] = "0.13.21";
+const quint64 Condition::FOMM_VERSION = (Q_UINT64_C(13) << 32) | (Q_UINT64_C(21) << 16);
+const quint64 Condition::UNPACKED_VERSION = ~Q_UINT64_C(0);
+
+
+namespace {
+
+// the four numbers of a version, each saturated at 32 bits
+std::array<quint64, 4> splitVersion(const QString &version)
+{
+  std::array<quint64, 4> result;
+  result.fill(0);
+  int pos = 0;
+  for (int part = 0; part < 4; ++part) {
+    if (part > 0) {
+      //Skip period
+      ++pos;
+    }
+    while ((pos < version.size()) && version.at(pos).isSpace()) {
+      ++pos;
+    }
+    int start = pos;
+    while ((pos < version.size()) && (version.at(pos) >= '0') && (version.at(pos) <= '9')) {
+      result[part] = std::min<quint64>(result[part] * 10 + (version.at(pos).unicode() - '0'), 0xFFFFFFFF);
+      ++pos;
+    }
+    if (pos == start) {
+      break;
+    }
+  }
+  return result;
+}
+
+}
+
+
+quint64 Condition::packVersion(const QString &version)
+{
+  quint64 result = 0;
+  for (quint64 number : splitVersion(version)) {
+    if (number >= 0xFFFF) {
+      return UNPACKED_VERSION;
+    }
+    result = (result << 16) | number;
+  }
+  return result;
+}
+
+bool Condition::versionLessEqual(const QString &lhs, const QString &rhs)
+{
+  return splitVersion(lhs) <= splitVersion(rhs);
+}
+
+
+StringPool::StringPool()
+{
+  add(QString());
+}
+
+int StringPool::add(const QString &string)
+{
+  auto iter = m_Indices.find(string);
+  if (iter == m_Indices.end()) {
+    iter = m_Indices.insert(string, static_cast<int>(m_Strings.size()));
+    m_Strings.push_back(string);
+  }
+  return *iter;
+}
+
+
+Condition Condition::flag(int name, int value)
+{
+  Condition result;
+  result.m_Type = TYPE_FLAG;
+  result.m_Name = name;
+  result.m_Value = value;
+  result.m_VersionType = VERSION_GAME;
+  result.m_Version = 0;
+  return result;
+}
+
+Condition Condition::file(int file, int state)
+{
+  Condition result = flag(file, state);
+  result.m_Type = TYPE_FILE;
+  return result;
+}
+
+Condition Condition::version(VersionType type, int requiredVersion, const QString &version)
+{
+  Condition result = flag(requiredVersion, 0);
+  result.m_Type = TYPE_VERSION;
+  result.m_VersionType = type;
+  result.m_Version = packVersion(version);
+  return result;
+}
+
+Condition Condition::sub(const SubCondition &condition)
+{
+  Condition result = flag(0, 0);
+  result.m_Type = TYPE_SUB;
+  result.m_Sub = condition;
+  return result;
+}
+
+
+bool FileDescriptor::byPriority(const FileDescriptor *LHS, const FileDescriptor *RHS)
+{
+  return LHS->m_Priority == RHS->m_Priority ?
+                LHS->m_FileSystemItemSequence < RHS->m_FileSystemItemSequence :
+                LHS->m_Priority < RHS->m_Priority;
+}
+
+
+FomodDocument::FomodDocument()
+{
+}
+
+FileDescriptor *FomodDocument::createFileDescriptor()
+{
+  m_FileDescriptors.push_back(FileDescriptor());
+  return &m_FileDescriptors.back();
+}
+
+DescriptorPath FomodDocument::addPath(const QString &path, bool folder)
+{
+  QString directory = path;
+  directory.replace('\\', '/');
+  QString name;
+  if (!folder) {
+    int pos = directory.lastIndexOf('/');
+    name = directory.mid(pos + 1);
+    directory.truncate(std::max(pos, 0));
+  }
+  directory = directory.split('/', QString::SkipEmptyParts).join('/');
+
+  DescriptorPath result;
+  result.m_Directory = addString(directory);
+  result.m_DirectoryKey = addString(directory.toCaseFolded());
+  result.m_Name = addString(name);
+  result.m_NameKey = addString(name.toCaseFolded());
+  return result;
+}
+
+int FomodDocument::addConditions(const std::vector<Condition> &conditions)
+{
+  int result = static_cast<int>(m_Conditions.size());
+  m_Conditions.insert(m_Conditions.end(), conditions.begin(), conditions.end());
+  return result;
+}
@@ -0,0 +1,287 @@
+#ifndef FOMODDOCUMENT_H
+#define FOMODDOCUMENT_H
+
+#include <QHash>
+#include <QString>
+
+#include <deque>
+#include <vector>
+
+enum ConditionOperator {
+  OP_AND,
+  OP_OR
+};
+
+/**
+ * @brief the strings of a document. Each distinct string is stored once and referred to by
+ *        its index. Index 0 is the empty string
+ */
+class StringPool {
+public:
+  StringPool();
+  int add(const QString &string);
+  const QString &at(int index) const { return m_Strings[index]; }
+  int size() const { return static_cast<int>(m_Strings.size()); }
+private:
+  std::vector<QString> m_Strings;
+  QHash<QString, int> m_Indices;
+};
+
+/**
+ * @brief operands combined with "and" or "or". The operands are stored consecutively in
+ *        the document the condition belongs to, see FomodDocument::condition
+ */
+struct SubCondition {
+  SubCondition() : m_Operator(OP_AND), m_First(0), m_Count(0), m_Index(-1) {}
+  ConditionOperator m_Operator;
+  int m_First;
+  int m_Count;
+  //Index of the compiled form of this condition, see CompiledConditions. Only set
+  //for top-level conditions
+  int m_Index;
+};
+
+/**
+ * @brief a node of a condition tree. Nodes are plain data owned by the document, strings
+ *        are indices into its string pool
+ */
+struct Condition {
+  enum Type { TYPE_FLAG, TYPE_FILE, TYPE_VERSION, TYPE_SUB };
+  enum VersionType { VERSION_GAME, VERSION_FOMM, VERSION_FOSE };
+
+  static Condition flag(int name, int value);
+  static Condition file(int file, int state);
+  static Condition version(VersionType type, int requiredVersion, const QString &version);
+  static Condition sub(const SubCondition &condition);
+
+  /**
+   * @brief convert a version string of up to four numbers to an integer. Each number takes
+   *        16 bits with the first one in the highest bits so versions compare as integers.
+   *        Parsing stops at the first part that isn't a number, missing parts are 0.
+   *        Versions with a number of 0xFFFF or more can't be packed, for those the result
+   *        is UNPACKED_VERSION and they have to be compared with versionLessEqual
+   */
+  static quint64 packVersion(const QString &version);
+  /**
+   * @return true if lhs is the same or an earlier version than rhs, comparing the numbers
+   *         as packVersion reads them but without limiting their size
+   */
+  static bool versionLessEqual(const QString &lhs, const QString &rhs);
+  static const quint64 UNPACKED_VERSION;
+  //The version we claim to be when asked for the fomm version. We should use
+  //IOrganizer::appVersion() but then we wouldn't be able to install anything as
+  //MO is at 0.3.11 at the time of writing.
+  static const char FOMM_VERSION_STRING[];
+  static const quint64 FOMM_VERSION;
+
+  Type m_Type;
+  //TYPE_FLAG: name and value of the flag. TYPE_FILE: file name and state.
+  //TYPE_VERSION: the required version in m_Name
+  int m_Name;
+  int m_Value;
+  VersionType m_VersionType;
+  //TYPE_VERSION: the required version as returned by packVersion
+  quint64 m_Version;
+  //TYPE_SUB: operator and operands
+  SubCondition m_Sub;
+};
+
+struct ConditionFlag {
+  ConditionFlag() : m_Name(), m_Value() {}
+  ConditionFlag(const QString &name, const QString &value) : m_Name(name), m_Value(value) { }
+  QString m_Name;
+  QString m_Value;
+};
+
+
+/**
+ * @brief a path of a file descriptor, split up when parsing so installing doesn't have to.
+ *        Separators are unified to '/' and the directory has none at either end. For a folder
+ *        the directory is the whole path and the name is empty. All members are indices into
+ *        the string pool of the document
+ */
+struct DescriptorPath {
+  DescriptorPath() : m_Directory(0), m_DirectoryKey(0), m_Name(0), m_NameKey(0) {}
+  int m_Directory;
+  //m_Directory case folded for lookups
+  int m_DirectoryKey;
+  int m_Name;
+  //m_Name case folded for lookups
+  int m_NameKey;
+};
+
+struct FileDescriptor {
+  FileDescriptor()
+    : m_Source(0), m_Destination(0), m_Priority(0), m_IsFolder(false), m_AlwaysInstall(false),
+      m_InstallIfUsable(false),
+      m_FileSystemItemSequence(0)
+  {}
+
+  static bool byPriority(const FileDescriptor *LHS, const FileDescriptor *RHS);
+
+  //Indices into the string pool of the document, as written in the xml
+  int m_Source;
+  int m_Destination;
+  DescriptorPath m_SourcePath;
+  DescriptorPath m_DestinationPath;
+  int m_Priority;
+  bool m_IsFolder;
+  bool m_AlwaysInstall;
+  bool m_InstallIfUsable;
+  int m_FileSystemItemSequence;
+};
+
+
+enum ItemOrder {
+  ORDER_ASCENDING,
+  ORDER_DESCENDING,
+  ORDER_EXPLICIT
+};
+
+enum GroupType {
+  TYPE_SELECTATLEASTONE,
+  TYPE_SELECTATMOSTONE,
+  TYPE_SELECTEXACTLYONE,
+  TYPE_SELECTANY,
+  TYPE_SELECTALL
+};
+
+enum PluginType {
+  TYPE_REQUIRED,
+  TYPE_RECOMMENDED,
+  TYPE_OPTIONAL,
+  TYPE_NOTUSABLE,
+  TYPE_COULDBEUSABLE
+};
+
+struct DependencyPattern {
+  PluginType type;
+  SubCondition condition;
+};
+
+typedef std::vector<DependencyPattern> DependencyPatternList;
+
+struct PluginTypeInfo
+{
+  PluginType m_DefaultType;
+  DependencyPatternList m_DependencyPatterns;
+};
+
+typedef std::vector<FileDescriptor*> FileDescriptorList;
+typedef std::vector<ConditionFlag> ConditionFlagList;
+
+struct Plugin {
+  QString m_Name;
+  QString m_Description;
+  QString m_ImagePath;
+  PluginTypeInfo m_PluginTypeInfo;
+  ConditionFlagList m_ConditionFlags;
+  FileDescriptorList m_Files;
+};
+
+struct Group {
+  QString m_Name;
+  GroupType m_Type;
+  std::vector<Plugin> m_Plugins;
+};
+
+struct InstallStep {
+  QString m_Name;
+  SubCondition m_Visible;
+  std::vector<Group> m_Groups;
+};
+
+struct ConditionalInstall {
+  SubCondition m_Condition;
+  FileDescriptorList m_Files;
+};
+
+/**
+ * @brief package information as found in fomod/info.xml
+ */
+struct FomodInfo {
+  FomodInfo() : m_ModID(-1) {}
+  QString m_Name;
+  QString m_Author;
+  QString m_Version;
+  QString m_Website;
+  int m_ModID;
+};
+
+/**
+ * @brief the parsed content of a ModuleConfig.xml. This contains no ui elements so it can be
+ *        created without a running QApplication and independently of the installer dialog.
+ *        Steps are stored in the order they are to be displayed, plugins in the order they
+ *        appear within their group.
+ */
+class FomodDocument {
+public:
+  FomodDocument();
+
+  /**
+   * @brief create a new file descriptor owned by this document
+   */
+  FileDescriptor *createFileDescriptor();
+
+  /**
+   * @return all file descriptors owned by this document in the order they were created
+   */
+  const std::deque<FileDescriptor> &fileDescriptors() const { return m_FileDescriptors; }
+
+  /**
+   * @return index of the string in the string pool, adding it if necessary
+   */
+  int addString(const QString &string) { return m_Strings.add(string); }
+
+  /**
+   * @brief split a path of a file descriptor and add its parts to the string pool
+   * @param folder if set the path names a directory, otherwise it ends with a file name
+   */
+  DescriptorPath addPath(const QString &path, bool folder);
+
+  /**
+   * @return a string from the string pool
+   */
+  const QString &string(int index) const { return m_Strings.at(index); }
+
+  /**
+   * @return the string pool of this document
+   */
+  const StringPool &strings() const { return m_Strings; }
+
+  /**
+   * @brief store the operands of a condition. Operands of nested conditions have to be stored
+   *        before the condition containing them
+   * @return index of the first operand
+   */
+  int addConditions(const std::vector<Condition> &conditions);
+
+  /**
+   * @return a stored condition node
+   */
+  const Condition &condition(int index) const { return m_Conditions[index]; }
+
+  /**
+   * @return all stored condition nodes
+   */
+  const std::vector<Condition> &conditions() const { return m_Conditions; }
+
+  QString m_ModuleName;
+  SubCondition m_ModuleDependencies;
+  FileDescriptorList m_RequiredFiles;
+  std::vector<InstallStep> m_Steps;
+  std::vector<ConditionalInstall> m_ConditionalInstalls;
+
+private:
+  FomodDocument(const FomodDocument&) = delete;
+  FomodDocument &operator=(const FomodDocument&) = delete;
+
+private:
+  //Descriptors and condition nodes are plain data kept in bulk. They are
+  //released all at once with the document
+  std::deque<FileDescriptor> m_FileDescriptors;
+  std::vector<Condition> m_Conditions;
+  StringPool m_Strings;
+};
+
+#endif // FOMODDOCUMENT_H
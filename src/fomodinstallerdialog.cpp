@@ -20,63 +20,40 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include "fomodinstallerdialog.h"
 #include "ui_fomodinstallerdialog.h"
 
+#include "fomodcache.h"
+#include "fomodparser.h"
 #include "imoinfo.h"
 #include "iplugingame.h"
 #include "report.h"
-#include "scopeguard.h"
 #include "scriptextender.h"
 #include "utility.h"
-#include "xmlreader.h"
 
 #include <QCheckBox>
 #include <QDebug>
 #include <QDir>
-#include <QFile>
+#include <QHash>
 #include <QImage>
 #include <QRadioButton>
 #include <QScrollArea>
-#include <QTextCodec>
+#include <QSet>
 
 #include <Shellapi.h>
 
-#include <boost/assign.hpp>
-
-#include <array>
-#include <sstream>
+#include <algorithm>
+#include <limits>
 
 using namespace MOBase;
 
 
-bool ControlsAscending(QAbstractButton *LHS, QAbstractButton *RHS)
-{
-  return LHS->text() < RHS->text();
-}
-
-
-bool ControlsDescending(QAbstractButton *LHS, QAbstractButton *RHS)
-{
-  return LHS->text() > RHS->text();
-}
-
-
-bool PagesAscending(QGroupBox *LHS, QGroupBox *RHS)
-{
-  return LHS->title() < RHS->title();
-}
-
-
-bool PagesDescending(QGroupBox *LHS, QGroupBox *RHS)
-{
-  return LHS->title() > RHS->title();
-}
+const int FomodInstallerDialog::NO_PRIORITY = std::numeric_limits<int>::min();
 
 
 FomodInstallerDialog::FomodInstallerDialog(const GuessedValue<QString> &modName, const QString &fomodPath,
-                                           const std::function<MOBase::IPluginList::PluginStates(const QString &)> &fileCheck,
+                                           const std::function<std::vector<MOBase::IPluginList::PluginStates>(const QStringList &)> &fileCheck,
                                            QWidget *parent)
   : QDialog(parent), ui(new Ui::FomodInstallerDialog), m_ModName(modName), m_ModID(-1),
-    m_FomodPath(fomodPath), m_Manual(false), m_FileCheck(fileCheck),
-    m_FileSystemItemSequence()
+    m_FomodPath(fomodPath), m_Manual(false), m_Document(new FomodDocument), m_CurrentStep(-1),
+    m_FileCheck(fileCheck)
 {
   ui->setupUi(this);
   setWindowTitle(modName);
@@ -93,7 +70,49 @@ FomodInstallerDialog::~FomodInstallerDialog()
 
 bool FomodInstallerDialog::hasOptions()
 {
-  return ui->stepsStack->count() > 0;
+  return !m_Document->m_Steps.empty();
+}
+
+
+void FomodInstallerDialog::refreshFileStates()
+{
+  //Resolve all files in one go so conditions never have to query the plugin list
+  QStringList files = CompiledConditions::fileDependencies(*m_Document);
+  std::vector<IPluginList::PluginStates> states = m_FileCheck(files);
+  m_Session.fileStates.clear();
+  for (int i = 0; i < files.size(); ++i) {
+    m_Session.fileStates.insert(files.at(i), toString(states[i]));
+  }
+
+  //File dependencies are folded into the compiled conditions so they have to be
+  //compiled again
+  compileConditions();
+  if (m_CurrentStep >= 0) {
+    displayCurrentPage(false);
+    updateNextbtnText();
+  }
+}
+
+
+void FomodInstallerDialog::compileConditions()
+{
+  m_Conditions.compile(*m_Document, m_Session);
+  //Once per document, or again if the file states were refreshed
+  qDebug("simplified conditions: %d nodes eliminated, %d dependency patterns and "
+         "%d conditional installs can never apply, %d groups reordered",
+         m_Conditions.eliminatedNodes(), m_Conditions.deadPatterns(),
+         m_Conditions.deadInstalls(), m_Conditions.reorderedGroups());
+
+  m_VisibilityCache.assign(m_Document->m_Steps.size(), VISIBILITY_UNKNOWN);
+  m_FlagDependents.clear();
+  for (int i = 0; i < static_cast<int>(m_Document->m_Steps.size()); ++i) {
+    for (int flag : m_Conditions.flags(m_Document->m_Steps[i].m_Visible.m_Index)) {
+      if (flag >= static_cast<int>(m_FlagDependents.size())) {
+        m_FlagDependents.resize(flag + 1);
+      }
+      m_FlagDependents[flag].push_back(i);
+    }
+  }
 }
 
 
@@ -121,141 +140,64 @@ int FomodInstallerDialog::bomOffset(const QByteArray &buffer)
   return 0;
 }
 
-struct XmlParseError : std::runtime_error {
-  XmlParseError(const QString &message)
-    : std::runtime_error(message.toUtf8().constData()) {}
-};
-
-QByteArray skipXmlHeader(QIODevice &file)
-{
-  static const unsigned char UTF16LE_BOM[] = { 0xFF, 0xFE };
-  static const unsigned char UTF16BE_BOM[] = { 0xFE, 0xFF };
-  static const unsigned char UTF8_BOM[]    = { 0xEF, 0xBB, 0xBF };
-  static const unsigned char UTF16LE[]     = { 0x3C, 0x00, 0x3F, 0x00 };
-  static const unsigned char UTF16BE[]     = { 0x00, 0x3C, 0x00, 0x3F };
-  static const unsigned char UTF8[]        = { 0x3C, 0x3F, 0x78, 0x6D };
-
-  file.seek(0);
-  QByteArray rawBytes = file.read(4);
-  QTextStream stream(&file);
-  int bom = 0;
-  if (rawBytes.startsWith((const char*)UTF16LE_BOM)) {
-    stream.setCodec("UTF16-LE");
-    bom = 2;
-  } else if (rawBytes.startsWith((const char*)UTF16BE_BOM)) {
-    stream.setCodec("UTF16-BE");
-    bom = 2;
-  } else if (rawBytes.startsWith((const char*)UTF8_BOM)) {
-    stream.setCodec("UTF-8");
-    bom = 3;
-  } else if (rawBytes.startsWith(QByteArray((const char *)UTF16LE, 4))) {
-    stream.setCodec("UTF16-LE");
-  } else if (rawBytes.startsWith(QByteArray((const char *)UTF16BE, 4))) {
-    stream.setCodec("UTF16-BE");
-  } else if (rawBytes.startsWith(QByteArray((const char*)UTF8, 4))) {
-    stream.setCodec("UTF-8");
-  } // otherwise maybe the textstream knows the encoding?
-
-  stream.seek(bom);
-  QString header = stream.readLine();
-  if (!header.startsWith("<?")) {
-    // it was all for nothing, there is no header here...
-    stream.seek(bom);
-  }
-  // this seems to be necessary due to buffering in QTextStream
-  file.seek(stream.pos());
-  return file.readAll();
-}
-
 void FomodInstallerDialog::readInfoXml()
 {
-  QFile file(QDir::tempPath() + "/" + m_FomodPath + "/fomod/info.xml");
-  if (file.open(QIODevice::ReadOnly)) {
-    bool success = false;
-    std::string errorMessage;
-    try {
-      QXmlStreamReader reader(&file);
-      parseInfo(reader);
-      success = true;
-    } catch (const XmlParseError &e) {
-      errorMessage = e.what();
-    }
+  FomodInfo info;
+  if (!FomodParser::readInfo(QDir::tempPath() + "/" + m_FomodPath + "/fomod/info.xml", info)) {
+    reportError(tr("Failed to parse ModuleConfig.xml. See console for details"));
+    return;
+  }
 
-    if (!success) {
-      // nmm's xml parser is less strict than the one from qt and allows files with
-      // wrong encoding in the header. Being strict here would be bad user experience
-      // this works around bad headers.
-      QByteArray headerlessData = skipXmlHeader(file);
-
-      // try parsing the file with several encodings to support broken files
-      foreach (const char *encoding, boost::assign::list_of("utf-16")("utf-8")("iso-8859-1")) {
-        qDebug("trying encoding %s", encoding);
-        try {
-          QTextCodec *codec = QTextCodec::codecForName(encoding);
-          XmlReader reader(codec->fromUnicode(QString("<?xml version=\"1.0\" encoding=\"%1\" ?>").arg(encoding)) + headerlessData);
-          parseInfo(reader);
-          qDebug("interpreting as %s", encoding);
-          success = true;
-          break;
-        } catch (const XmlParseError &e) {
-          qDebug("not %s: %s", encoding, e.what());
-        }
-      }
-      if (!success) {
-        reportError(tr("Failed to parse ModuleConfig.xml. See console for details"));
-      }
-    }
-    file.close();
+  if (!info.m_Name.isEmpty()) {
+    m_ModName.update(info.m_Name, GUESS_META);
+    updateNameEdit();
+  }
+  if (!info.m_Author.isEmpty()) {
+    ui->authorLabel->setText(info.m_Author);
+  }
+  if (!info.m_Version.isEmpty()) {
+    ui->versionLabel->setText(info.m_Version);
+  }
+  m_ModID = info.m_ModID;
+  if (!info.m_Website.isEmpty()) {
+    m_URL = info.m_Website;
+    ui->websiteLabel->setText(tr("<a href=\"%1\">Link</a>").arg(m_URL));
+    ui->websiteLabel->setToolTip(m_URL);
   }
 }
 
 void FomodInstallerDialog::readModuleConfigXml()
 {
-  QFile file(QDir::tempPath() + "/" + m_FomodPath + "/fomod/ModuleConfig.xml");
-  if (!file.open(QIODevice::ReadOnly)) {
-    throw MyException(tr("ModuleConfig.xml missing"));
+  FomodCache cache(FomodCache::defaultDirectory());
+  std::unique_ptr<FomodDocument> document =
+      FomodParser::readModuleConfig(QDir::tempPath() + "/" + m_FomodPath + "/fomod/ModuleConfig.xml", &cache);
+  if (document.get() == nullptr) {
+    reportError(tr("Failed to parse ModuleConfig.xml. See console for details"));
+    return;
   }
+  m_Document = std::move(document);
+  refreshFileStates();
 
-  bool success = false;
-  std::string errorMessage;
-  try {
-    XmlReader reader(&file);
-    parseModuleConfig(reader);
-    success = true;
-  } catch (const XmlParseError &e) {
-    qWarning("the ModuleConfig.xml in this file is incorrectly encoded (%s). Applying heuristics...", e.what());
-  }
-
-  if (!success) {
-    // nmm's xml parser is less strict than the one from qt and allows files with
-    // wrong encoding in the header. Being strict here would be bad user experience
-    // this works around bad headers.
-    QByteArray headerlessData = skipXmlHeader(file);
-
-    // try parsing the file with several encodings to support broken files
-    foreach (const char *encoding, boost::assign::list_of("utf-16")("utf-8")("iso-8859-1")) {
-      try {
-        QTextCodec *codec = QTextCodec::codecForName(encoding);
-        XmlReader reader(codec->fromUnicode(QString("<?xml version=\"1.0\" encoding=\"%1\" ?>").arg(encoding)) + headerlessData);
-        parseModuleConfig(reader);
-        qDebug("interpreting as %s", encoding);
-        success = true;
-        break;
-      } catch (const XmlParseError &e) {
-        qDebug("not %s: %s", encoding, e.what());
-      }
-    }
-    if (!success) {
-      reportError(tr("Failed to parse ModuleConfig.xml. See console for details"));
-    }
+  if (!testCondition(-1, m_Document->m_ModuleDependencies)) {
+    //TODO Better messages?
+    throw MyException("This module is not usable with this setup");
+  }
+
+  initSteps();
 
-    file.close();
+  if (!m_Document->m_Steps.empty()) {
+    //FIXME It is be possible for the first page to be inactive in which case this is
+    //going to go wrong.
+    showStep(0);
+    displayCurrentPage();
+    activateCurrentPage();
   }
 }
 
 void FomodInstallerDialog::initData(IOrganizer *moInfo)
 {
   m_MoInfo = moInfo;
+  readVersions();
 
   // parse provided package information
   readInfoXml();
@@ -302,85 +244,48 @@ void FomodInstallerDialog::moveTree(DirectoryTree::Node *target, DirectoryTree::
 }
 
 
-DirectoryTree::Node *FomodInstallerDialog::findNode(DirectoryTree::Node *node, const QString &path, bool create)
+DirectoryTree::Node *FomodInstallerDialog::findNode(DirectoryIndex *index, const InstallPlan &plan,
+                                                   const DescriptorPath &path, bool create)
 {
-  if (path.length() == 0) {
-    return node;
-  }
-
-  int pos = path.indexOf(QRegExp("[\\\\/]"));
-  QString subPath = path;
-  if (pos > 0) {
-    subPath = path.mid(0, pos);
-  }
-  for (DirectoryTree::const_node_iterator iter = node->nodesBegin(); iter != node->nodesEnd(); ++iter) {
-    if ((*iter)->getData().name == subPath) {
-      if (pos <= 0) {
-        return *iter;
-      } else {
-        return findNode(*iter, path.mid(pos + 1), create);
-      }
-    }
-  }
-  if (create) {
-    DirectoryTree::Node *newNode = new DirectoryTree::Node;
-    newNode->setData(subPath);
-    node->addNode(newNode, false);
-    if (pos <= 0) {
-      return newNode;
-    } else {
-      return findNode(newNode, path.mid(pos + 1), create);
-    }
-  } else {
-    throw MyException(QString("%1 not found in archive").arg(path));
+  QString const &directory = plan.string(path.m_Directory);
+  DirectoryTree::Node *result = index->find(directory, plan.string(path.m_DirectoryKey), create);
+  if (result == nullptr) {
+    throw MyException(QString("%1 not found in archive").arg(directory));
   }
+  return result;
 }
 
-void FomodInstallerDialog::copyLeaf(DirectoryTree::Node *sourceTree, const QString &sourcePath,
-                                    DirectoryTree::Node *destinationTree, const QString &destinationPath,
+void FomodInstallerDialog::copyLeaf(DirectoryIndex *sourceIndex, DirectoryTree::Node *sourceNode,
+                                    const InstallPlan &plan, const DescriptorPath &sourcePath,
+                                    DirectoryTree::Node *destinationNode, const QString &destinationName,
                                     DirectoryTree::Overwrites *overwrites,
-                                    Leaves *leaves, int pri)
+                                    LeafPriorities *priorities, int priority)
 {
-  int sourceFileIndex = sourcePath.lastIndexOf('\\');
-  if (sourceFileIndex == -1) {
-    sourceFileIndex = sourcePath.lastIndexOf('/');
-    if (sourceFileIndex == -1) {
-      sourceFileIndex = 0;
-    }
+  //All files with the name are copied in reverse order, so the first one in the
+  //source directory is the one that remains
+  std::vector<const FileTreeInformation*> const &files =
+      sourceIndex->files(sourceNode, plan.string(sourcePath.m_NameKey));
+  for (const FileTreeInformation *file : files) {
+    setPriority(priorities, static_cast<int>(file->getIndex()), priority);
+    FileTreeInformation temp = *file;
+    temp.setName(destinationName);
+    destinationNode->addLeaf(temp, true, overwrites);
   }
-  DirectoryTree::Node *sourceNode = sourceFileIndex == 0 ? sourceTree : findNode(sourceTree, sourcePath.mid(0, sourceFileIndex), false);
-  applyPriority(leaves, sourceNode, pri);
-
-  int destinationFileIndex = destinationPath.lastIndexOf('\\');
-  if (destinationFileIndex == -1) {
-    destinationFileIndex = destinationPath.lastIndexOf('/');
-    if (destinationFileIndex == -1) {
-      destinationFileIndex = 0;
-    }
-  }
-
-  DirectoryTree::Node *destinationNode =
-      destinationFileIndex == 0 ? destinationTree
-                                : findNode(destinationTree, destinationPath.mid(0, destinationFileIndex), true);
-
-  QString sourceName = sourcePath.mid((sourceFileIndex != 0) ? sourceFileIndex + 1 : 0);
-  QString destinationName = (destinationFileIndex != 0) ? destinationPath.mid(destinationFileIndex + 1) : destinationPath;
-  if (destinationName.length() == 0) {
-    destinationName = sourceName;
+  if (files.empty()) {
+    qCritical("%s not found!", plan.string(sourcePath.m_Name).toUtf8().constData());
   }
+}
 
-  bool found = false;
-  for (DirectoryTree::const_leaf_reverse_iterator iter = sourceNode->leafsRBegin();
-       iter != sourceNode->leafsREnd(); ++iter) {
-    if (iter->getName() == sourceName) {
-      FileTreeInformation temp = *iter;
-      temp.setName(destinationName);
-      destinationNode->addLeaf(temp, true, overwrites);
-      found = true;
+//Full paths of the specified files in a tree
+void collectPaths(DirectoryTree::Node *node, const QSet<int> &leaves, QHash<int, QString> *paths)
+{
+  for (DirectoryTree::leaf_iterator iter = node->leafsBegin(); iter != node->leafsEnd(); ++iter) {
+    if (leaves.contains(static_cast<int>(iter->getIndex()))) {
+      paths->insert(static_cast<int>(iter->getIndex()), node->getFullPath(&*iter));
     }
   }
-  if (!found) {
-    qCritical("%s not found!", sourceName.toUtf8().constData());
+  for (DirectoryTree::node_iterator iter = node->nodesBegin(); iter != node->nodesEnd(); ++iter) {
+    collectPaths(*iter, leaves, paths);
   }
 }
 
@@ -397,68 +302,128 @@ void dumpTree(DirectoryTree::Node *node, int indent)
   }
 }
 
-void FomodInstallerDialog::applyPriority(Leaves *leaves, DirectoryTree::Node *node, int priority)
+void FomodInstallerDialog::setPriority(LeafPriorities *priorities, int leaf, int priority)
+{
+  if (leaf >= static_cast<int>(priorities->size())) {
+    priorities->resize(leaf + 1, NO_PRIORITY);
+  }
+  //The first operation to reach a file determines its priority
+  if ((*priorities)[leaf] == NO_PRIORITY) {
+    (*priorities)[leaf] = priority;
+  }
+}
+
+void FomodInstallerDialog::applyPriority(LeafPriorities *priorities, DirectoryTree::Node *node, int priority)
 {
   for (DirectoryTree::leaf_iterator iter = node->leafsBegin(); iter != node->leafsEnd(); ++iter) {
-    LeafInfo info = { priority, node->getFullPath(&*iter) };
-    leaves->insert(std::make_pair(static_cast<int>(iter->getIndex()), info));
+    setPriority(priorities, static_cast<int>(iter->getIndex()), priority);
   }
   for (DirectoryTree::node_iterator iter = node->nodesBegin(); iter != node->nodesEnd(); ++iter) {
-    applyPriority(leaves, *iter, priority);
+    applyPriority(priorities, *iter, priority);
+  }
+}
+
+void FomodInstallerDialog::warnSamePriority(DirectoryTree::Node *archive, DirectoryTree *tree,
+                                            const LeafPriorities &priorities,
+                                            const DirectoryTree::Overwrites &overwrites)
+{
+  auto priority = [&priorities] (int leaf) {
+    return leaf < static_cast<int>(priorities.size()) ? priorities[leaf] : NO_PRIORITY;
+  };
+
+  QHash<int, int> replacedBy;
+  bool anyConflict = false;
+  for (auto overwrite : overwrites) {
+    replacedBy.insert(overwrite.first, overwrite.second);
+    anyConflict = anyConflict || (priority(overwrite.first) == priority(overwrite.second));
+  }
+  if (!anyConflict) {
+    return;
+  }
+
+  //Both files end up at the same path. The file that replaced the other one may have
+  //been replaced in turn so the path is that of whichever file is installed there now
+  auto installed = [&replacedBy] (int leaf) {
+    for (int i = 0; replacedBy.contains(leaf) && (i < replacedBy.size()); ++i) {
+      leaf = replacedBy.value(leaf);
+    }
+    return leaf;
+  };
+
+  //Paths are only determined for the files involved. Both files of an overwrite share
+  //the destination, they are named by their path in the archive. Files in subdirectories
+  //of a folder operation have been moved out of the archive, those are found in the tree
+  QSet<int> involved;
+  for (auto overwrite : overwrites) {
+    if (priority(overwrite.first) == priority(overwrite.second)) {
+      involved.insert(overwrite.first);
+      involved.insert(overwrite.second);
+      involved.insert(installed(overwrite.second));
+    }
+  }
+  QHash<int, QString> sourcePaths;
+  collectPaths(archive, involved, &sourcePaths);
+  QHash<int, QString> paths;
+  collectPaths(tree, involved, &paths);
+
+  auto name = [&sourcePaths, &paths] (int leaf) {
+    if (sourcePaths.contains(leaf)) {
+      return sourcePaths.value(leaf);
+    } else if (paths.contains(leaf)) {
+      return paths.value(leaf);
+    } else {
+      return QString("#%1").arg(leaf);
+    }
+  };
+
+  for (auto overwrite : overwrites) {
+    if (priority(overwrite.first) == priority(overwrite.second)) {
+      qWarning() << "Overriding file" << name(overwrite.first) << "with file" << name(overwrite.second)
+                 << "which has the same priority at" << paths.value(installed(overwrite.second));
+    }
   }
 }
 
-bool FomodInstallerDialog::copyFileIterator(DirectoryTree *sourceTree, DirectoryTree *destinationTree,
-                                            const FileDescriptor *descriptor,
-                                            Leaves *leaves, DirectoryTree::Overwrites *overwrites)
+bool FomodInstallerDialog::copyFileIterator(DirectoryIndex *sourceIndex, DirectoryIndex *destinationIndex,
+                                            const InstallPlan &plan, const InstallPlan::Operation &operation,
+                                            LeafPriorities *priorities, DirectoryTree::Overwrites *overwrites)
 {
-  QString source = (m_FomodPath.length() != 0) ? (m_FomodPath + "\\" + descriptor->m_Source)
-                                               : descriptor->m_Source;
-  int pri = descriptor->m_Priority;
-  QString destination = descriptor->m_Destination;
+  DescriptorPath const &sourcePath = operation.source;
+  DescriptorPath const &destinationPath = operation.destination;
+  int pri = operation.priority;
   try {
-    if (descriptor->m_IsFolder) {
-      DirectoryTree::Node *sourceNode = findNode(sourceTree, source, false);
+    DirectoryTree::Node *sourceNode = findNode(sourceIndex, plan, sourcePath, false);
+    DirectoryTree::Node *targetNode = findNode(destinationIndex, plan, destinationPath, true);
+    if (operation.folder) {
       //Now apply the priority to the sourceNode tree
-      applyPriority(leaves, sourceNode, pri);
-      DirectoryTree::Node *targetNode = findNode(destinationTree, destination, true);
+      applyPriority(priorities, sourceNode, pri);
+      //Directories below the source are detached or merged away, the ones below the
+      //target may change
+      sourceIndex->invalidate(plan.string(sourcePath.m_DirectoryKey));
+      destinationIndex->invalidate(plan.string(destinationPath.m_DirectoryKey));
       moveTree(targetNode, sourceNode, overwrites);
     } else {
-      copyLeaf(sourceTree, source, destinationTree, destination, overwrites, leaves, pri);
+      QString const &sourceName = plan.string(sourcePath.m_Name);
+      QString const &destinationName = plan.string(destinationPath.m_Name);
+      copyLeaf(sourceIndex, sourceNode, plan, sourcePath,
+               targetNode, destinationName.isEmpty() ? sourceName : destinationName, overwrites,
+               priorities, pri);
     }
     return true;
   } catch (const MyException &e) {
-    qCritical("failed to extract %s to %s: %s",
-              source.toUtf8().constData(), destination.toUtf8().constData(), e.what());
+    qCritical("failed to extract %s/%s to %s/%s: %s",
+              plan.string(sourcePath.m_Directory).toUtf8().constData(),
+              plan.string(sourcePath.m_Name).toUtf8().constData(),
+              plan.string(destinationPath.m_Directory).toUtf8().constData(),
+              plan.string(destinationPath.m_Name).toUtf8().constData(), e.what());
     return false;
   }
 }
 
 
-bool FomodInstallerDialog::testCondition(int maxIndex, const ValueCondition *valCondition) const
-{
-  return testCondition(maxIndex, valCondition->m_Name, valCondition->m_Value);
-}
-
-bool FomodInstallerDialog::testCondition(int maxIndex, const ConditionFlag *conditionFlag) const
-{
-  return testCondition(maxIndex, conditionFlag->m_Name, conditionFlag->m_Value);
-}
-
-bool FomodInstallerDialog::testCondition(int maxIndex, const SubCondition *condition) const
+bool FomodInstallerDialog::testCondition(int maxIndex, const SubCondition &condition) const
 {
-  ConditionOperator op = condition->m_Operator;
-  for (const Condition *cond : condition->m_Conditions) {
-    bool conditionMatches = cond->test(maxIndex, this);
-    if (op == OP_OR && conditionMatches) {
-      return true;
-    }
-    if (op == OP_AND && !conditionMatches) {
-      return false;
-    }
-  }
-  //If we get through here, everything matched (AND) or nothing matched (OR)
-  return op == OP_AND;
+  return m_Conditions.evaluate(condition.m_Index, maxIndex, *this);
 }
 
 QString FomodInstallerDialog::toString(IPluginList::PluginStates state)
@@ -469,80 +434,40 @@ QString FomodInstallerDialog::toString(IPluginList::PluginStates state)
   throw MyException(tr("invalid plugin state %1").arg(state));
 }
 
-bool FomodInstallerDialog::testCondition(int, const FileCondition *condition) const
-{
-  return toString(m_FileCheck(condition->m_File)) == condition->m_State;
-}
-
-namespace {
-class Version
-{
-public:
-  explicit Version(QString const &v);
-
-  friend bool operator<=(Version const &, Version const &);
-
-private:
-  std::array<int, 4> m_version;
-};
-
-Version::Version(QString const &v)
+void FomodInstallerDialog::readVersions()
 {
-  std::istringstream parser(v.toStdString());
-  m_version.fill(0);
-  parser >> m_version[0];
-  for (int idx = 1; idx < 4; idx++)
-  {
-      parser.get(); //Skip period
-      parser >> m_version[idx];
+  //Determining these may require reading the version resources of executables so
+  //it's only done once per dialog
+  MOBase::IPluginGame const *game = m_MoInfo->managedGame();
+  m_Session.gameVersionString = game->gameVersion();
+  m_Session.gameVersion = Condition::packVersion(m_Session.gameVersionString);
+  ScriptExtender *extender = game->feature<ScriptExtender>();
+  if (extender != nullptr) {
+    m_Session.extenderVersionString = extender->getExtenderVersion();
+    m_Session.extenderVersion = Condition::packVersion(m_Session.extenderVersionString);
   }
 }
 
-bool operator<=(Version const &lhs, Version const &rhs)
+DirectoryTree *FomodInstallerDialog::updateTree(DirectoryTree *tree)
 {
-  return lhs.m_version <= rhs.m_version;
+  CompiledConditions::Statistics const &statistics = m_Conditions.statistics();
+  qDebug("condition evaluations: %d, flag tests: %d, short-circuited: %d",
+         statistics.evaluations, statistics.flagTests, statistics.shortCircuitedTests);
+  return applyPlan(installPlan(), tree);
 }
 
-}
-bool FomodInstallerDialog::testCondition(int, const VersionCondition *condition) const
-{
-  QString version;
-  MOBase::IPluginGame const *game = m_MoInfo->managedGame();
-
-  switch (condition->m_Type) {
-    case VersionCondition::v_Game: {
-      version = game->gameVersion();
-    } break;
-
-    case VersionCondition::v_FOMM:
-      //We should use m_MoInfo->appVersion() but then we wouldn't be able to
-      //install anything as MO is at 0.3.11 at the time of writing.
-      version = "0.13.21";
-      break;
-
-    case VersionCondition::v_FOSE: {
-      ScriptExtender *extender = game->feature<ScriptExtender>();
-      if (extender != nullptr) {
-        version = extender->getExtenderVersion();
-      }
-    } break;
-  }
-  return Version(condition->m_RequiredVersion) <= Version(version);
-}
-
-DirectoryTree *FomodInstallerDialog::updateTree(DirectoryTree *tree)
+InstallPlan FomodInstallerDialog::installPlan() const
 {
   FileDescriptorList descriptorList;
 
   // enable all required files
-  for (FileDescriptor *file : m_RequiredFiles) {
+  for (FileDescriptor *file : m_Document->m_RequiredFiles) {
     descriptorList.push_back(file);
   }
 
   // enable all conditional file installs (files programatically selected by conditions instead of a user selection. usually dependencies)
-  for (ConditionalInstall &cond : m_ConditionalInstalls) {
-    SubCondition *condition = &cond.m_Condition;
-    if (condition->test(ui->stepsStack->count(), this)) {
+  for (ConditionalInstall const &cond : m_Document->m_ConditionalInstalls) {
+    if (testCondition(static_cast<int>(m_Document->m_Steps.size()), cond.m_Condition)) {
       for (FileDescriptor *file : cond.m_Files) {
         descriptorList.push_back(file);
       }
@@ -550,331 +475,105 @@ DirectoryTree *FomodInstallerDialog::updateTree(DirectoryTree *tree)
   }
 
   // enable all user-enabled choices
-  for (int i = 0; i < ui->stepsStack->count(); ++i) {
+  for (int i = 0; i < static_cast<int>(m_Document->m_Steps.size()); ++i) {
     if (testVisible(i)) {
-      QList<QAbstractButton*> choices = ui->stepsStack->widget(i)->findChildren<QAbstractButton*>("choice");
-      for (QAbstractButton* choice : choices) {
-        if (choice->isChecked()) {
-          QVariantList fileList = choice->property("files").toList();
-          for (QVariant fileVariant : fileList) {
-            descriptorList.push_back(fileVariant.value<FileDescriptor*>());
+      std::vector<Group> const &groups = m_Document->m_Steps[i].m_Groups;
+      StepState const &state = m_StepStates[i];
+      for (size_t group = 0; group < groups.size(); ++group) {
+        for (size_t plugin = 0; plugin < groups[group].m_Plugins.size(); ++plugin) {
+          if (state.checked[group][plugin]) {
+            for (FileDescriptor *file : groups[group].m_Plugins[plugin].m_Files) {
+              descriptorList.push_back(file);
+            }
           }
         }
       }
     }
   }
 
-  std::sort(descriptorList.begin(), descriptorList.end(), byPriority);
-
-  DirectoryTree *newTree = new DirectoryTree;
-  Leaves leaves;
-  DirectoryTree::Overwrites overwrites;
+  std::sort(descriptorList.begin(), descriptorList.end(), FileDescriptor::byPriority);
 
+  InstallPlan result;
   for (const FileDescriptor *file : descriptorList) {
-    copyFileIterator(tree, newTree, file, &leaves, &overwrites);
-  }
-
-  for (auto overwrite : overwrites) {
-    if (leaves[overwrite.first].priority == leaves[overwrite.second].priority) {
-      qWarning() << "Overriding " << leaves[overwrite.first].path << " with " <<
-                    leaves[overwrite.second].path << " which has the same priority";
-    }
-  }
-  return newTree;
-}
-
-
-void FomodInstallerDialog::highlightControl(QAbstractButton *button)
-{
-  QVariant screenshotName = button->property("screenshot");
-  if (screenshotName.isValid()) {
-    QString screenshotFileName = screenshotName.toString();
-    if (!screenshotFileName.isEmpty()) {
-      QString temp = QDir::tempPath() + "/" + m_FomodPath + "/" + QDir::fromNativeSeparators(screenshotFileName);
-      QImage screenshot(temp);
-      if (screenshot.isNull()) {
-        qWarning(">%s< is a null image", qPrintable(temp));
-      } else {
-        QPixmap tempPix = QPixmap::fromImage(screenshot);
-        ui->screenshotLabel->setScalablePixmap(tempPix);
-      }
-    } else {
-      ui->screenshotLabel->setPixmap(QPixmap());
-    }
-  }
-  ui->descriptionText->setText(button->property("description").toString());
-}
-
-
-bool FomodInstallerDialog::eventFilter(QObject *object, QEvent *event)
-{
-  QAbstractButton *button = qobject_cast<QAbstractButton*>(object);
-  if ((button != nullptr) && (event->type() == QEvent::HoverEnter)) {
-    highlightControl(button);
-  }
-  return QDialog::eventFilter(object, event);
-}
-
-
-QString FomodInstallerDialog::readContent(QXmlStreamReader &reader)
-{
-  if (reader.readNext() == XmlReader::Characters) {
-    return reader.text().toString();
-  } else {
-    return QString();
-  }
-}
-
-
-void FomodInstallerDialog::parseInfo(QXmlStreamReader &reader)
-{
-  while (!reader.atEnd()) {
-    switch (reader.readNext()) {
-      case QXmlStreamReader::StartElement: {
-        if (reader.name() == "Name") {
-          m_ModName.update(readContent(reader), GUESS_META);
-          updateNameEdit();
-        } else if (reader.name() == "Author") {
-          ui->authorLabel->setText(readContent(reader));
-        } else if (reader.name() == "Version") {
-          ui->versionLabel->setText(readContent(reader));
-        } else if (reader.name() == "Id") {
-          m_ModID = readContent(reader).toInt();
-        } else if (reader.name() == "Website") {
-          m_URL = readContent(reader);
-          ui->websiteLabel->setText(tr("<a href=\"%1\">Link</a>").arg(m_URL));
-          ui->websiteLabel->setToolTip(m_URL);
-        }
-      } break;
-      default: {} break;
-    }
-  }
-  if (reader.hasError()) {
-    throw XmlParseError(QString("%1 in line %2").arg(reader.errorString()).arg(reader.lineNumber()));
+    result.add(*m_Document, *file);
   }
+  return result;
 }
 
-
-FomodInstallerDialog::ItemOrder FomodInstallerDialog::getItemOrder(const QString &orderString)
+DirectoryTree *FomodInstallerDialog::applyPlan(const InstallPlan &plan, DirectoryTree *tree)
 {
-  if (orderString == "Ascending") {
-    return ORDER_ASCENDING;
-  } else if (orderString == "Descending") {
-    return ORDER_DESCENDING;
-  } else if (orderString == "Explicit") {
-    return ORDER_EXPLICIT;
-  } else {
-    throw MyException(tr("unsupported order type %1").arg(orderString));
-  }
-}
-
+  DirectoryTree *newTree = new DirectoryTree;
+  LeafPriorities priorities;
+  DirectoryTree::Overwrites overwrites;
 
-FomodInstallerDialog::GroupType FomodInstallerDialog::getGroupType(const QString &typeString)
-{
-  if (typeString == "SelectAtLeastOne") {
-    return TYPE_SELECTATLEASTONE;
-  } else if (typeString == "SelectAtMostOne") {
-    return TYPE_SELECTATMOSTONE;
-  } else if (typeString == "SelectExactlyOne") {
-    return TYPE_SELECTEXACTLYONE;
-  } else if (typeString == "SelectAny") {
-    return TYPE_SELECTANY;
-  } else if (typeString == "SelectAll") {
-    return TYPE_SELECTALL;
-  } else {
-    throw MyException(tr("unsupported group type %1").arg(typeString));
+  //Source paths are relative to the fomod directory so look that up once and index
+  //the archive from there
+  DirectoryTree::Node *fomodNode = DirectoryIndex::search(tree, m_FomodPath);
+  if (fomodNode == nullptr) {
+    qCritical("%s not found in archive", qPrintable(m_FomodPath));
+    return newTree;
   }
-}
-
 
-FomodInstallerDialog::PluginType FomodInstallerDialog::getPluginType(const QString &typeString)
-{
-  if (typeString == "Required") {
-    return FomodInstallerDialog::TYPE_REQUIRED;
-  } else if (typeString == "Optional") {
-    return FomodInstallerDialog::TYPE_OPTIONAL;
-  } else if (typeString == "Recommended") {
-    return FomodInstallerDialog::TYPE_RECOMMENDED;
-  } else if (typeString == "NotUsable") {
-    return FomodInstallerDialog::TYPE_NOTUSABLE;
-  } else if (typeString == "CouldBeUsable") {
-    return FomodInstallerDialog::TYPE_COULDBEUSABLE;
-  } else {
-    qCritical("invalid plugin type %s", typeString.toUtf8().constData());
-    return FomodInstallerDialog::TYPE_OPTIONAL;
+  //Every operation looks up one or two directories, resolve them through an
+  //index instead of searching the trees each time
+  DirectoryIndex sourceIndex(fomodNode);
+  DirectoryIndex destinationIndex(newTree);
+  for (const InstallPlan::Operation &operation : plan.operations()) {
+    copyFileIterator(&sourceIndex, &destinationIndex, plan, operation, &priorities, &overwrites);
   }
-}
 
-
-void FomodInstallerDialog::readFileList(XmlReader &reader, FileDescriptorList &fileList)
-{
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "folder" || reader.name() == "file") {
-      QXmlStreamAttributes attributes = reader.attributes();
-      //This is a horrendous hack. It doesn't make sense to specify an empty source folder name,
-      //as it would require you to copy everything including the fomod directory. However, people
-      //have been known to write entries like <folder source="" destination=""/> in order to
-      //achieve an option that does nothing. Are groups and buttons that hard?
-      //An empty source file is very probably a serious error but given people do the above, I'm
-      //assuming that they probably assume <file source="" destination=""/> will work the same,
-      //so I'm not differentiating.
-      //Similarly, I'm not checking for the destination if the source is blank. Why'd you want to
-      //copy the fomod directory on an install?
-      if (attributes.value("source").isEmpty()) {
-        qDebug("Ignoring %s entry with empty source.", reader.name().toUtf8().constData());
-      } else {
-        FileDescriptor *file = new FileDescriptor(this);
-        file->m_Source = attributes.value("source").toString();
-        file->m_Destination = attributes.hasAttribute("destination") ? attributes.value("destination").toString()
-                                                                     : file->m_Source;
-        file->m_Priority = attributes.hasAttribute("priority") ? attributes.value("priority").toString().toInt()
-                                                               : 0;
-        file->m_FileSystemItemSequence = ++m_FileSystemItemSequence;
-        file->m_IsFolder = reader.name() == "folder";
-        file->m_InstallIfUsable = attributes.hasAttribute("installIfUsable") ? (attributes.value("installIfUsable").compare("true") == 0)
-                                                                             : false;
-        file->m_AlwaysInstall = attributes.hasAttribute("alwaysInstall") ? (attributes.value("alwaysInstall").compare("true") == 0)
-                                                                         : false;
-
-        fileList.push_back(file);
-      }
-      reader.finishedElement();
-    } else {
-      reader.unexpected();
-    }
-  }
+  warnSamePriority(fomodNode, newTree, priorities, overwrites);
+  return newTree;
 }
 
-void FomodInstallerDialog::readDependencyPattern(XmlReader &reader, DependencyPattern &pattern)
-{
-  //sequence
-  //  dependency
-  //  type
-  QString self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "dependencies") {
-      readCompositeDependency(reader, pattern.condition);
-    } else if (reader.name() == "type") {
-      pattern.type = getPluginType(reader.attributes().value("name").toString());
-      reader.finishedElement();
-    } else {
-      reader.unexpected();
-    }
-  }
-}
 
-void FomodInstallerDialog::readDependencyPatternList(XmlReader &reader, DependencyPatternList &patterns)
+const Plugin &FomodInstallerDialog::optionPlugin(int option) const
 {
-  QString self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "pattern") {
-      DependencyPattern pattern;
-      readDependencyPattern(reader, pattern);
-      patterns.push_back(pattern);
-    } else {
-      reader.unexpected();
-    }
-  }
+  Option const &position = m_Options[option];
+  return m_Document->m_Steps[position.step].m_Groups[position.group].m_Plugins[position.plugin];
 }
 
-void FomodInstallerDialog::readDependencyPluginType(XmlReader &reader, PluginTypeInfo &info)
-{
-  //sequence
-  // defaultType
-  // patterns
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "defaultType") {
-      info.m_DefaultType = getPluginType(reader.attributes().value("name").toString());
-      reader.finishedElement();
-    } else if (reader.name() == "patterns") {
-      readDependencyPatternList(reader, info.m_DependencyPatterns);
-    } else {
-      reader.unexpected();
-    }
-  }
-}
 
-void FomodInstallerDialog::readPluginType(XmlReader &reader, Plugin &plugin)
+void FomodInstallerDialog::highlightControl(int option)
 {
-  //Have a choice here of precisely one of 'type' or 'dependencytype', so this is
-  //not strictly necessary
-  plugin.m_PluginTypeInfo.m_DefaultType = TYPE_OPTIONAL;
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "type") {
-      plugin.m_PluginTypeInfo.m_DefaultType = getPluginType(reader.attributes().value("name").toString());
-      reader.finishedElement();
-    } else if (reader.name() == "dependencyType") {
-      readDependencyPluginType(reader, plugin.m_PluginTypeInfo);
-    } else {
-      reader.unexpected();
-    }
+  if (option < 0) {
+    //The "None" button has neither screenshot nor description
+    ui->descriptionText->setText(QString());
+    return;
   }
-}
-
-
-void FomodInstallerDialog::readConditionFlagList(XmlReader &reader, ConditionFlagList &condflags)
-{
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "flag") {
-      QString name = reader.attributes().value("name").toString();
-      QString content = reader.getText();
-      condflags.push_back(ConditionFlag(name, content));
+  Plugin const &plugin = optionPlugin(option);
+  if (!plugin.m_ImagePath.isEmpty()) {
+    QString temp = QDir::tempPath() + "/" + m_FomodPath + "/" + QDir::fromNativeSeparators(plugin.m_ImagePath);
+    QImage screenshot(temp);
+    if (screenshot.isNull()) {
+      qWarning(">%s< is a null image", qPrintable(temp));
     } else {
-      reader.unexpected();
+      QPixmap tempPix = QPixmap::fromImage(screenshot);
+      ui->screenshotLabel->setScalablePixmap(tempPix);
     }
+  } else {
+    ui->screenshotLabel->setPixmap(QPixmap());
   }
+  ui->descriptionText->setText(plugin.m_Description);
 }
 
 
-bool FomodInstallerDialog::byPriority(const FileDescriptor *LHS, const FileDescriptor *RHS)
-{
-  return LHS->m_Priority == RHS->m_Priority ?
-                LHS->m_FileSystemItemSequence < RHS->m_FileSystemItemSequence :
-                LHS->m_Priority < RHS->m_Priority;
-}
-
-
-FomodInstallerDialog::Plugin FomodInstallerDialog::readPlugin(XmlReader &reader)
+bool FomodInstallerDialog::eventFilter(QObject *object, QEvent *event)
 {
-  Plugin result;
-  result.m_Name = reader.attributes().value("name").toString();
-
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "description") {
-      result.m_Description = reader.getText().trimmed();
-    } else if (reader.name() == "image") {
-      result.m_ImagePath = reader.attributes().value("path").toString();
-      reader.finishedElement();
-    } else if (reader.name() == "files") {
-      readFileList(reader, result.m_Files);
-    } else if (reader.name() == "conditionFlags") {
-      readConditionFlagList(reader, result.m_ConditionFlags);
-    } else if (reader.name() == "typeDescriptor") {
-      readPluginType(reader, result);
-    } else {
-      reader.unexpected();
-    }
+  QAbstractButton *button = qobject_cast<QAbstractButton*>(object);
+  if ((button != nullptr) && (event->type() == QEvent::HoverEnter)) {
+    QVariant option = button->property("option");
+    highlightControl(option.isValid() ? option.toInt() : -1);
   }
-
-  //I (TRT) am not quite sure why this sort is done here. It is done again
-  //when the files have been selected before installing them, which seems
-  //a more appropriate place.
-  std::sort(result.m_Files.begin(), result.m_Files.end(), byPriority);
-
-  return result;
+  return QDialog::eventFilter(object, event);
 }
 
 
-FomodInstallerDialog::PluginType FomodInstallerDialog::getPluginDependencyType(int page, const PluginTypeInfo &info) const
+PluginType FomodInstallerDialog::getPluginDependencyType(int page, const PluginTypeInfo &info) const
 {
   if (info.m_DependencyPatterns.size() != 0) {
     for (const DependencyPattern &pattern : info.m_DependencyPatterns) {
-      if (testCondition(page, &pattern.condition)) {
+      if (testCondition(page, pattern.condition)) {
           return pattern.type;
       }
     }
@@ -882,54 +581,15 @@ FomodInstallerDialog::PluginType FomodInstallerDialog::getPluginDependencyType(i
   return info.m_DefaultType;
 }
 
-void FomodInstallerDialog::readPluginList(XmlReader &reader, QString const &groupName, GroupType &groupType, QLayout *layout)
+void FomodInstallerDialog::createPluginControls(const Group &group, int firstOption,
+                                                const std::vector<bool> &checked, QLayout *layout)
 {
-  ItemOrder pluginOrder = reader.attributes().hasAttribute("order") ? getItemOrder(reader.attributes().value("order").toString())
-                                                                    : ORDER_ASCENDING;
-
-  // Read in all the plugins so we can check if the author is using "atmost" or "exactly",
-  // and correct as appropriate
-  std::vector<Plugin> plugins;
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "plugin") {
-      plugins.push_back(readPlugin(reader));
-    } else {
-      reader.unexpected();
-    }
-  }
-
-  std::vector<QAbstractButton*> controls;
-  //This is somewhat of a hack. If the author has specified only 1 plugin and the
-  //group type is SELECTATLEASTONE or SELECTEXACTLYONE, then that plugin has to
-  //be selected. A note: This doesn't check for if somebody has defined a single
-  //plugin group with one of the above types, and then made the plugin unselectable.
-  //They deserve what they get.
-  //Similarly, if they've specfied SELECTATMOSTONE, we might as well give them
-  //a checkbox
-  if (plugins.size() == 1) {
-    switch (groupType) {
-      case TYPE_SELECTATLEASTONE: {
-        qWarning() << "Plugin " << plugins[0].m_Name << " is the only plugin specified in group " <<
-                        groupName << " which requires selection of at least one plugin";
-        groupType = TYPE_SELECTALL;
-      } break;
-      case TYPE_SELECTEXACTLYONE: {
-        qWarning() << "Plugin " << plugins[0].m_Name << " is the only plugin specified in group " <<
-                        groupName << " which requires selection of exactly one plugin";
-        groupType = TYPE_SELECTALL;
-      } break;
-      case TYPE_SELECTATMOSTONE: {
-        qWarning() << "Plugin " << plugins[0].m_Name << " is the only plugin specified in group " <<
-                        groupName << " which permits selection of at most one plugin";
-        groupType = TYPE_SELECTANY;
-      } break;
-    }
-  }
-
-  for (Plugin const &plugin : plugins) {
+  std::vector<QAbstractButton*> &controls = m_PageControls.back();
+  bool anyChecked = false;
+  for (size_t i = 0; i < group.m_Plugins.size(); ++i) {
+    Plugin const &plugin = group.m_Plugins[i];
     QAbstractButton *newControl = nullptr;
-    switch (groupType) {
+    switch (group.m_Type) {
       case TYPE_SELECTATLEASTONE:
       case TYPE_SELECTANY: {
         newControl = new QCheckBox(plugin.m_Name);
@@ -945,73 +605,44 @@ void FomodInstallerDialog::readPluginList(XmlReader &reader, QString const &grou
         newControl->setToolTip(tr("All components in this group are required"));
       } break;
     }
+    if (checked[i]) {
+      newControl->setChecked(true);
+      anyChecked = true;
+    }
     newControl->setObjectName("choice");
     newControl->setAttribute(Qt::WA_Hover);
-    QVariant type(qVariantFromValue(plugin.m_PluginTypeInfo));
-    newControl->setProperty("plugintypeinfo", type);
-    newControl->setProperty("screenshot", plugin.m_ImagePath);
-    newControl->setProperty("description", plugin.m_Description);
-    QVariantList fileList;
-    //This looks horrible...
-    for (FileDescriptor * const &descriptor : plugin.m_Files) {
-      fileList.append(qVariantFromValue(descriptor));
-    }
-    newControl->setProperty("files", fileList);
-    QVariantList conditionFlags;
-    for (ConditionFlag const &conditionFlag : plugin.m_ConditionFlags) {
-      if (! conditionFlag.m_Name.isEmpty()) {
-        conditionFlags.append(qVariantFromValue(conditionFlag));
-
-      }
-    }
-    newControl->setProperty("conditionFlags", conditionFlags);
+    newControl->setProperty("option", firstOption + static_cast<int>(i));
     newControl->installEventFilter(this);
     //We need somehow to check the 'toggled' signal. how do I do that
     //void QAbstractButton::clicked ( bool checked ) [signal]
     connect(newControl, SIGNAL(clicked()), this, SLOT(widgetButtonClicked()));
+    layout->addWidget(newControl);
     controls.push_back(newControl);
   }
 
-  if (pluginOrder == ORDER_ASCENDING) {
-    std::sort(controls.begin(), controls.end(), ControlsAscending);
-  } else if (pluginOrder == ORDER_DESCENDING) {
-    std::sort(controls.begin(), controls.end(), ControlsDescending);
-  }
-
-  for (QAbstractButton * const control : controls) {
-    layout->addWidget(control);
-  }
-
-  if (groupType == TYPE_SELECTATMOSTONE) {
+  if (group.m_Type == TYPE_SELECTATMOSTONE) {
     QRadioButton *newButton = new QRadioButton(tr("None"));
     newButton->setObjectName("none");
+    newButton->setChecked(!anyChecked);
     layout->addWidget(newButton);
+    m_NoneButtons.back() = newButton;
   }
 }
 
 
-void FomodInstallerDialog::readGroup(XmlReader &reader, QLayout *layout)
+void FomodInstallerDialog::createGroup(const Group &group, int firstOption,
+                                       const std::vector<bool> &checked, QLayout *layout)
 {
-  QString name = reader.attributes().value("name").toString();
-  GroupType type = getGroupType(reader.attributes().value("type").toString());
-
-  QGroupBox *groupBox = new QGroupBox(name);
+  QGroupBox *groupBox = new QGroupBox(group.m_Name);
 
   QVBoxLayout *groupLayout = new QVBoxLayout;
 
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "plugins") {
-      readPluginList(reader, name, type, groupLayout);
-    } else {
-      reader.unexpected();
-    }
-  }
+  m_PageControls.push_back(std::vector<QAbstractButton*>());
+  m_NoneButtons.push_back(nullptr);
+  createPluginControls(group, firstOption, checked, groupLayout);
 
-  groupLayout->setProperty("groupType", qVariantFromValue(type));
-  groupLayout->setObjectName("grouplayout");
   groupBox->setLayout(groupLayout);
-  if (type == TYPE_SELECTATLEASTONE) {
+  if (group.m_Type == TYPE_SELECTATLEASTONE) {
     QLabel *label = new QLabel(tr("Select one or more of these options:"));
     layout->addWidget(label);
   }
@@ -1020,47 +651,18 @@ void FomodInstallerDialog::readGroup(XmlReader &reader, QLayout *layout)
 }
 
 
-void FomodInstallerDialog::readGroupList(XmlReader &reader, QLayout *layout)
+QGroupBox *FomodInstallerDialog::createStepPage(int index)
 {
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "group") {
-      readGroup(reader, layout);
-    } else {
-      reader.unexpected();
-    }
-  }
-}
-
-QGroupBox *FomodInstallerDialog::readInstallStep(XmlReader &reader)
-{
-  QString name = reader.attributes().value("name").toString();
-  QGroupBox *page = new QGroupBox(name);
+  InstallStep const &step = m_Document->m_Steps[index];
+  StepState const &state = m_StepStates[index];
+  QGroupBox *page = new QGroupBox(step.m_Name);
   QVBoxLayout *pageLayout = new QVBoxLayout;
   QScrollArea *scrollArea = new QScrollArea;
   QFrame *scrolledArea = new QFrame;
   QVBoxLayout *scrollLayout = new QVBoxLayout;
 
-  SubCondition subcondition;
-
-  //sequence:
-  //  visible (optional)
-  //  optionalFileGroups
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "visible") {
-      readCompositeDependency(reader, subcondition);
-    } else if (reader.name() == "optionalFileGroups") {
-      readGroupList(reader, scrollLayout);
-    } else {
-      reader.unexpected();
-    }
-  }
-
-  if (subcondition.m_Conditions.size() != 0) {
-    //FIXME Is this actually OK? I'm storing a pointer in the property?
-    //Also AFAICS this is subject to memory leaks
-    page->setProperty("conditional", qVariantFromValue(subcondition));
+  for (size_t i = 0; i < step.m_Groups.size(); ++i) {
+    createGroup(step.m_Groups[i], m_FirstOptions[index][i], state.checked[i], scrollLayout);
   }
 
   scrolledArea->setLayout(scrollLayout);
@@ -1072,190 +674,97 @@ QGroupBox *FomodInstallerDialog::readInstallStep(XmlReader &reader)
 }
 
 
-void FomodInstallerDialog::readStepList(XmlReader &reader)
-{
-  ItemOrder stepOrder = reader.attributes().hasAttribute("order") ? getItemOrder(reader.attributes().value("order").toString())
-                                                                    : ORDER_ASCENDING;
-
-  std::vector<QGroupBox*> pages;
-
-  //sequence installStep (1 or more)
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "installStep") {
-      pages.push_back(readInstallStep(reader));
-    } else {
-      reader.unexpected();
+void FomodInstallerDialog::initSteps()
+{
+  //Pages are only created once they are displayed. Until then all that's needed
+  //is the initial selection
+  m_StepStates.clear();
+  m_PluginFlags.clear();
+  m_Options.clear();
+  m_FirstOptions.clear();
+  m_FlagState.clear();
+  for (int stepIndex = 0; stepIndex < static_cast<int>(m_Document->m_Steps.size()); ++stepIndex) {
+    InstallStep const &step = m_Document->m_Steps[stepIndex];
+    StepState state;
+    state.previous = -1;
+    std::vector<std::vector<CompiledConditions::FlagValueList>> stepFlags;
+    std::vector<int> firstOptions;
+    for (int groupIndex = 0; groupIndex < static_cast<int>(step.m_Groups.size()); ++groupIndex) {
+      Group const &group = step.m_Groups[groupIndex];
+      state.checked.push_back(std::vector<bool>(group.m_Plugins.size(), group.m_Type == TYPE_SELECTALL));
+      firstOptions.push_back(static_cast<int>(m_Options.size()));
+      std::vector<CompiledConditions::FlagValueList> groupFlags;
+      for (int pluginIndex = 0; pluginIndex < static_cast<int>(group.m_Plugins.size()); ++pluginIndex) {
+        Option option = { stepIndex, groupIndex, pluginIndex };
+        m_Options.push_back(option);
+        groupFlags.push_back(m_Conditions.internFlags(group.m_Plugins[pluginIndex].m_ConditionFlags));
+      }
+      stepFlags.push_back(groupFlags);
     }
-  }
-
-  if (stepOrder == ORDER_ASCENDING) {
-    std::sort(pages.begin(), pages.end(), PagesAscending);
-  } else if (stepOrder == ORDER_DESCENDING) {
-    std::sort(pages.begin(), pages.end(), PagesDescending);
-  }
-
-  for (std::vector<QGroupBox*>::const_iterator iter = pages.begin(); iter != pages.end(); ++iter) {
-    ui->stepsStack->addWidget(*iter);
+    m_StepStates.push_back(state);
+    m_PluginFlags.push_back(stepFlags);
+    m_FirstOptions.push_back(firstOptions);
   }
 }
 
 
-void FomodInstallerDialog::readCompositeDependency(XmlReader &reader, SubCondition &conditional)
+void FomodInstallerDialog::showStep(int index)
 {
-  conditional.m_Operator = OP_AND;
-  if (reader.attributes().hasAttribute("operator")) {
-    QStringRef dependencyOperator = reader.attributes().value("operator");
-    if (dependencyOperator == "Or") {
-      conditional.m_Operator = OP_OR;
-    } else if (dependencyOperator != "And") {
-      qWarning() << "Expected 'and' or 'or' at line " << reader.lineNumber() << ", got " << dependencyOperator;
-    } // OP_AND is the default, set at the beginning of the function
-  }
-
-  QString const self = reader.name().toString();
-  while (reader.getNextElement(self)) {
-    QStringRef name = reader.name();
-    if (name == "fileDependency") {
-      conditional.m_Conditions.push_back(new FileCondition(reader.attributes().value("file").toString(),
-                                                           reader.attributes().value("state").toString()));
-      reader.finishedElement();
-    } else if (name == "flagDependency") {
-      conditional.m_Conditions.push_back(new ValueCondition(reader.attributes().value("flag").toString(),
-                                                            reader.attributes().value("value").toString()));
-      reader.finishedElement();
-    } else if (name == "gameDependency") {
-      conditional.m_Conditions.push_back(new VersionCondition(VersionCondition::v_Game,
-                                                              reader.attributes().value("version").toString()));
-      reader.finishedElement();
-    } else if (name == "fommDependency") {
-      conditional.m_Conditions.push_back(new VersionCondition(VersionCondition::v_FOMM,
-                                                              reader.attributes().value("version").toString()));
-      reader.finishedElement();
-    } else if (name == "foseDependency") {
-      conditional.m_Conditions.push_back(new VersionCondition(VersionCondition::v_FOSE,
-                                                              reader.attributes().value("version").toString()));
-      reader.finishedElement();
-    } else if (name == "dependencies") {
-      SubCondition *nested = new SubCondition();
-      readCompositeDependency(reader, *nested);
-      conditional.m_Conditions.push_back(nested);
-    } else {
-      reader.unexpected();
-    }
-  }
-  if (conditional.m_Conditions.size() == 0) {
-    qWarning() << "Empty conditional found at line " << reader.lineNumber();
+  //Only the current page is kept around, the one we leave can be recreated from
+  //its selection state
+  QWidget *oldPage = ui->stepsStack->currentWidget();
+  if (oldPage != nullptr) {
+    saveCurrentPage();
+    ui->stepsStack->removeWidget(oldPage);
+    oldPage->deleteLater();
   }
-}
+  m_PageControls.clear();
+  m_NoneButtons.clear();
 
-
-FomodInstallerDialog::ConditionalInstall FomodInstallerDialog::readConditionalInstallPattern(XmlReader &reader)
-{
-  ConditionalInstall result;
-  result.m_Condition.m_Operator = OP_AND;
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "dependencies") {
-      readCompositeDependency(reader, result.m_Condition);
-    } else if (reader.name() == "files") {
-      readFileList(reader, result.m_Files);
-    } else {
-      reader.unexpected();
-    }
-  }
-  return result;
+  m_CurrentStep = index;
+  ui->stepsStack->addWidget(createStepPage(index));
+  ui->stepsStack->setCurrentIndex(0);
 }
 
-void FomodInstallerDialog::readConditionalFilePatternList(XmlReader &reader)
-{
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "pattern") {
-      m_ConditionalInstalls.push_back(readConditionalInstallPattern(reader));
-    } else {
-      reader.unexpected();
-    }
-  }
-}
 
-void FomodInstallerDialog::readConditionalFileInstallList(XmlReader &reader)
+void FomodInstallerDialog::saveCurrentPage()
 {
-  QString const self(reader.name().toString());
-  //Technically there should be only one but it's easier to write like this
-  while (reader.getNextElement(self)) {
-    if (reader.name() == "patterns") {
-      readConditionalFilePatternList(reader);
-    } else {
-      reader.unexpected();
+  if (m_CurrentStep < 0) {
+    return;
+  }
+  StepState &state = m_StepStates[m_CurrentStep];
+  for (size_t group = 0; group < m_PageControls.size(); ++group) {
+    for (size_t plugin = 0; plugin < m_PageControls[group].size(); ++plugin) {
+      state.checked[group][plugin] = m_PageControls[group][plugin]->isChecked();
     }
   }
+  m_FlagState.updatePage(m_CurrentStep, pageFlags(m_CurrentStep));
+  invalidateVisibility();
 }
 
 
-void FomodInstallerDialog::readModuleConfiguration(XmlReader &reader)
+CompiledConditions::FlagValueList FomodInstallerDialog::pageFlags(int page) const
 {
-  //sequence:
-  //  modulename
-  //  optional - moduleImage
-  //  optional - moduleDependencies
-  //  optional - requiredInstallFiles
-  //  optional - installSteps
-  //  optional - conditionalFileInstalls
-  QString const self(reader.name().toString());
-  while (reader.getNextElement(self)) {
-    QStringRef name = reader.name();
-    if (name == "moduleName") {
-      QString title = reader.getText();
-      qDebug() << "module name : "  << title;
-    } else if (name == "moduleImage") {
-      //do something useful with the attributes of this
-      reader.finishedElement();
-    } else if (name == "moduleDependencies") {
-      SubCondition condition;
-      readCompositeDependency(reader, condition);
-      if (!testCondition(-1, &condition)) {
-        //TODO Better messages?
-        throw MyException("This module is not usable with this setup");
+  //If several checked plugins set the same flag the first one wins
+  CompiledConditions::FlagValueList result;
+  auto const &groups = m_PluginFlags[page];
+  StepState const &state = m_StepStates[page];
+  for (size_t group = 0; group < groups.size(); ++group) {
+    for (size_t plugin = 0; plugin < groups[group].size(); ++plugin) {
+      if (state.checked[group][plugin]) {
+        for (CompiledConditions::FlagValue const &setting : groups[group][plugin]) {
+          auto iter = std::find_if(result.begin(), result.end(),
+                                   [&setting] (CompiledConditions::FlagValue const &existing) {
+                                     return existing.flag == setting.flag;
+                                   });
+          if (iter == result.end()) {
+            result.push_back(setting);
+          }
+        }
       }
-    } else if (name == "requiredInstallFiles") {
-      readFileList(reader, m_RequiredFiles);
-    } else if (name == "installSteps") {
-      readStepList(reader);
-    } else if (name == "conditionalFileInstalls") {
-      readConditionalFileInstallList(reader);
-    } else {
-      reader.unexpected();
     }
   }
-}
-
-void FomodInstallerDialog::parseModuleConfig(XmlReader &reader)
-{
-  if (reader.readNext() != XmlReader::StartDocument) {
-    throw XmlParseError(QString("Expected document start at line %1").arg(reader.lineNumber()));
-  }
-  processXmlTag(reader, "config", &FomodInstallerDialog::readModuleConfiguration);
-  if (reader.readNext() != XmlReader::EndDocument) {
-    throw XmlParseError(QString("Expected document end at line %1").arg(reader.lineNumber()));
-  }
-  if (reader.hasError()) {
-    throw XmlParseError(QString("%1 in line %2").arg(reader.errorString()).arg(reader.lineNumber()));
-  }
-  //FIXME It is be possible for the first page to be inactive in which case this is
-  //going to go wrong.
-  displayCurrentPage();
-  activateCurrentPage();
-}
-
-
-void FomodInstallerDialog::processXmlTag(XmlReader &reader, char const *tag, TagProcessor func)
-{
-  if (reader.readNext() == XmlReader::StartElement && reader.name() == tag) {
-    (this->*func)(reader);
-  } else if (! reader.hasError()) {
-    reader.raiseError(QString("Expected %1, got %2").arg(tag).arg(reader.name().toString()));
-  }
+  return result;
 }
 
 
@@ -1279,44 +788,23 @@ void FomodInstallerDialog::on_websiteLabel_linkActivated(const QString &link)
 
 void FomodInstallerDialog::activateCurrentPage()
 {
-  QList<QAbstractButton*> choices = ui->stepsStack->currentWidget()->findChildren<QAbstractButton*>("choice");
-  if (choices.count() > 0) {
-    highlightControl(choices.at(0));
+  for (size_t group = 0; group < m_PageControls.size(); ++group) {
+    if (!m_PageControls[group].empty()) {
+      highlightControl(m_FirstOptions[m_CurrentStep][group]);
+      break;
+    }
   }
   m_PageVisible.push_back(true);
+  m_FlagState.enterPage(m_CurrentStep, pageFlags(m_CurrentStep));
+  invalidateVisibility();
   updateNextbtnText();
 }
 
-bool FomodInstallerDialog::testCondition(int maxIndex, const QString &flag, const QString &value) const
+bool FomodInstallerDialog::testFlag(int maxIndex, int flag, int value) const
 {
-  //FIXME Review this and see if we can store the visible and evaluated variables for each
-  //page and cache like that. This would make me happier (if no one else) about the results
-  //of doing 'previous' and changing a flag to 'unset'.
-
-  // iterate through all enabled condition flags on all activated controls on
-  // all visible pages if one of them matches the condition, taking the most
-  // recent setting.
-  for (int i = maxIndex - 1; i >= 0; --i) {
-    if (testVisible(i)) {
-      QWidget *page = ui->stepsStack->widget(i);
-      QList<QAbstractButton*> choices = page->findChildren<QAbstractButton*>("choice");
-      for (QAbstractButton const *choice : choices) {
-        if (choice->isChecked()) {
-          QVariant temp = choice->property("conditionFlags");
-          if (temp.isValid()) {
-            QVariantList conditionFlags = temp.toList();
-            for (QVariant const &variant : conditionFlags) {
-              ConditionFlag condition = variant.value<ConditionFlag>();
-              if (condition.m_Name == flag) {
-                return condition.m_Value == value;
-              }
-            }
-          }
-        }
-      }
-    }
-  }
-  return value.isEmpty();
+  // the most recent setting of the flag on a visible page before maxIndex. Pages
+  // after the current one haven't been entered so they can't have set anything
+  return m_FlagState.value(flag, maxIndex) == value;
 }
 
 
@@ -1325,29 +813,43 @@ bool FomodInstallerDialog::testVisible(int pageIndex) const
   if (pageIndex < static_cast<int>(m_PageVisible.size())) {
     return m_PageVisible[pageIndex];
   }
-  if (pageIndex >= ui->stepsStack->count()) {
+  if (pageIndex >= static_cast<int>(m_Document->m_Steps.size())) {
     return false;
   }
-  QWidget *page = ui->stepsStack->widget(pageIndex);
-  QVariant subcond = page->property("conditional");
-  if (subcond.isValid()) {
-    SubCondition subc = subcond.value<SubCondition>();
-    return testCondition(pageIndex, &subc);
+  Visibility &cached = m_VisibilityCache[pageIndex];
+  if (cached == VISIBILITY_UNKNOWN) {
+    SubCondition const &condition = m_Document->m_Steps[pageIndex].m_Visible;
+    bool visible = (condition.m_Count == 0) || testCondition(pageIndex, condition);
+    cached = visible ? VISIBILITY_VISIBLE : VISIBILITY_HIDDEN;
+  }
+  return cached == VISIBILITY_VISIBLE;
+}
+
+
+void FomodInstallerDialog::invalidateVisibility()
+{
+  //Steps after the current one only see the flags of the pages entered so far,
+  //so their visibility can only change along with one of those flags
+  for (int flag : m_FlagState.takeChangedFlags()) {
+    if (flag < static_cast<int>(m_FlagDependents.size())) {
+      for (int page : m_FlagDependents[flag]) {
+        m_VisibilityCache[page] = VISIBILITY_UNKNOWN;
+      }
+    }
   }
-  return true;
 }
 
 
 bool FomodInstallerDialog::nextPage()
 {
-  int oldIndex = ui->stepsStack->currentIndex();
+  int oldIndex = m_CurrentStep;
 
   int index = oldIndex + 1;
   // find the next "visible" install step
-  while (index < ui->stepsStack->count()) {
+  while (index < static_cast<int>(m_Document->m_Steps.size())) {
     if (testVisible(index)) {
-      ui->stepsStack->setCurrentIndex(index);
-      ui->stepsStack->currentWidget()->setProperty("previous", oldIndex);
+      m_StepStates[index].previous = oldIndex;
+      showStep(index);
       return true;
     }
     m_PageVisible.push_back(false);
@@ -1360,8 +862,9 @@ bool FomodInstallerDialog::nextPage()
 
 void FomodInstallerDialog::widgetButtonClicked()
 {
-  //A button has been clicked. At the moment we do nothing with this
-  //beyond checking the next button state
+  //A button has been clicked. Conditions on later pages are evaluated from the
+  //stored selection so bring that up to date before checking the next button state
+  saveCurrentPage();
   updateNextbtnText();
 }
 
@@ -1370,28 +873,18 @@ void FomodInstallerDialog::updateNextbtnText()
   //First we see if we can actually allow the 'next' button. Specifically, this
   //is a test to ensure that you have selected at least one item in a
   //'select at least one' box.
-  int const page = ui->stepsStack->currentIndex();
+  int const page = m_CurrentStep;
   QStringList groups_requiring_selection;
-  for (QVBoxLayout const * const layout : ui->stepsStack->widget(page)->findChildren<QVBoxLayout*>("grouplayout")) {
-    GroupType const groupType(layout->property("groupType").value<GroupType>());
-    if (groupType == TYPE_SELECTATLEASTONE) {
+  std::vector<Group> const &groups = m_Document->m_Steps[page].m_Groups;
+  for (size_t group = 0; group < groups.size(); ++group) {
+    if (groups[group].m_Type == TYPE_SELECTATLEASTONE) {
       //Check at least one of this group is ticked
-      bool checked = false;
-      for (int i = 0; i != layout->count(); ++i) {
-        if (QLayoutItem * item = layout->itemAt(i)) {
-          QAbstractButton * const choice = dynamic_cast<QAbstractButton *>(item->widget());
-          if (choice != nullptr) {
-            if (choice->objectName() == "choice" && choice->isChecked()) {
-              checked = true;
-              break;
-            }
-          }
-        }
-      }
+      std::vector<QAbstractButton*> const &controls = m_PageControls[group];
+      bool checked = std::any_of(controls.begin(), controls.end(),
+                                 [] (QAbstractButton const *choice) { return choice->isChecked(); });
       if (!checked) {
-        QString group = dynamic_cast<QGroupBox*>(layout->parentWidget())->title();
-        qDebug() << "Group " << group << " needs a selection";
-        groups_requiring_selection.append(group);
+        qDebug() << "Group " << groups[group].m_Name << " needs a selection";
+        groups_requiring_selection.append(groups[group].m_Name);
       }
     }
   }
@@ -1410,45 +903,27 @@ void FomodInstallerDialog::updateNextbtnText()
   //Display 'next' or 'install' as appropriate for the next button.
   //note this can change depending on what buttons you click here.
 
-  auto old_PageVisible = m_PageVisible;
-  ON_BLOCK_EXIT([&] () {
-    m_PageVisible = old_PageVisible;
-  });
-
   bool isLast = true;
-  for (int index = page + 1; index != ui->stepsStack->count(); ++index) {
+  for (int index = page + 1; index < static_cast<int>(m_Document->m_Steps.size()); ++index) {
     if (testVisible(index)) {
       isLast = false;
       break;
     }
-    m_PageVisible.push_back(false);
   }
 
   ui->nextBtn->setEnabled(true);
   ui->nextBtn->setText(isLast ? tr("Install") : tr("Next"));
 }
 
-void FomodInstallerDialog::displayCurrentPage()
+void FomodInstallerDialog::displayCurrentPage(bool applyDefaults)
 {
   //Iterate over all buttons and set the tool tips as appropriate
-  int const page = ui->stepsStack->currentIndex();
-  for (QVBoxLayout *layout : ui->stepsStack->widget(page)->findChildren<QVBoxLayout*>("grouplayout")) {
-    //Create a list of buttons, as in order to attempt to keep users existing choices intact, we
-    //may need to cycle over this twice
-    QList<QAbstractButton *> controls;
-    QAbstractButton *none_button(nullptr);
-    for (int i = 0; i != layout->count(); ++i) {
-      if (QLayoutItem * const item = layout->itemAt(i)) {
-        QAbstractButton * const choice = dynamic_cast<QAbstractButton *>(item->widget());
-        if (choice != nullptr) {
-          if (choice->objectName() == "choice") {
-            controls.push_back(choice);
-          } else if (choice->objectName() == "none") {
-            none_button = choice;
-          }
-        }
-      }
-    }
+  int const page = m_CurrentStep;
+  std::vector<Group> const &groups = m_Document->m_Steps[page].m_Groups;
+  for (size_t group = 0; group < groups.size(); ++group) {
+    std::vector<QAbstractButton*> const &controls = m_PageControls[group];
+    QAbstractButton * const none_button = m_NoneButtons[group];
+    std::vector<Plugin> const &plugins = groups[group].m_Plugins;
 
     //FIXME If we are displaying this for the 2nd time, we should do two passes,
     //as currently if you have decided against a recommended option, gone back,
@@ -1457,7 +932,7 @@ void FomodInstallerDialog::displayCurrentPage()
     //in here, all tick boxes are clear, which is a valid condition. For radio
     //buttons, that's not a valid condition so we can override. But we should
     //possibly override anyway if the plugin types have changed since last time.
-    GroupType groupType(layout->property("groupType").value<GroupType>());
+    GroupType const groupType = groups[group].m_Type;
     if (groupType != TYPE_SELECTALL) {
       bool const mustSelectOne = groupType == TYPE_SELECTEXACTLYONE ||
                                  groupType == TYPE_SELECTATLEASTONE;
@@ -1465,9 +940,9 @@ void FomodInstallerDialog::displayCurrentPage()
       QAbstractButton *first_optional = nullptr;
       QAbstractButton *first_couldbe = nullptr;
 
-      for (QAbstractButton * const control : controls) {
-        PluginTypeInfo const info = control->property("plugintypeinfo").value<PluginTypeInfo>();
-        PluginType const type = getPluginDependencyType(page, info);
+      for (size_t plugin = 0; plugin < controls.size(); ++plugin) {
+        QAbstractButton * const control = controls[plugin];
+        PluginType const type = getPluginDependencyType(page, plugins[plugin].m_PluginTypeInfo);
         control->setEnabled(true);
         switch (type) {
           case TYPE_REQUIRED: {
@@ -1488,7 +963,7 @@ void FomodInstallerDialog::displayCurrentPage()
             control->setToolTip(tr("This component is required"));
           } break;
           case TYPE_RECOMMENDED: {
-            if (maySelectMore || !mustSelectOne) {
+            if (applyDefaults && (maySelectMore || !mustSelectOne)) {
               control->setChecked(true);
             }
             control->setToolTip(tr("It is recommended you enable this component"));
@@ -1517,7 +992,7 @@ void FomodInstallerDialog::displayCurrentPage()
           maySelectMore = false;
         }
       }
-      if (maySelectMore) {
+      if (applyDefaults && maySelectMore) {
         if (none_button != nullptr) {
           none_button->setChecked(true);
         } else if (mustSelectOne) {
@@ -1535,11 +1010,12 @@ void FomodInstallerDialog::displayCurrentPage()
       }
     }
   }
+  saveCurrentPage();
 }
 
 void FomodInstallerDialog::on_nextBtn_clicked()
 {
-  if (ui->stepsStack->currentIndex() == ui->stepsStack->count() - 1) {
+  if (m_CurrentStep == static_cast<int>(m_Document->m_Steps.size()) - 1) {
     this->accept();
   } else {
     if (nextPage()) {
@@ -1555,19 +1031,21 @@ void FomodInstallerDialog::on_nextBtn_clicked()
 void FomodInstallerDialog::on_prevBtn_clicked()
 {
   //FIXME this will go wrong if the first page isn't visible
-  if (ui->stepsStack->currentIndex() != 0) {
-    int previousIndex = 0;
-    QVariant temp = ui->stepsStack->currentWidget()->property("previous");
-    if (temp.isValid()) {
-      previousIndex = temp.toInt();
-    } else {
-      previousIndex = ui->stepsStack->currentIndex() - 1;
+  if (m_CurrentStep != 0) {
+    int previousIndex = m_StepStates[m_CurrentStep].previous;
+    if (previousIndex < 0) {
+      previousIndex = m_CurrentStep - 1;
     }
-    ui->stepsStack->setCurrentIndex(previousIndex);
     m_PageVisible.resize(previousIndex);
+    m_FlagState.leavePages(previousIndex);
+    invalidateVisibility();
+    showStep(previousIndex);
+    //The page is recreated so restore enables and tool tips but leave the
+    //selection the user made alone
+    displayCurrentPage(false);
     ui->nextBtn->setText(tr("Next"));
   }
-  if (ui->stepsStack->currentIndex() == 0) {
+  if (m_CurrentStep == 0) {
     ui->prevBtn->setEnabled(false);
   }
   activateCurrentPage();
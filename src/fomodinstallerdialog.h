@@ -20,8 +20,13 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef FOMODINSTALLERDIALOG_H
 #define FOMODINSTALLERDIALOG_H
 
+#include "compiledconditions.h"
+#include "directoryindex.h"
 #include "directorytree.h"
+#include "flagstate.h"
+#include "fomoddocument.h"
 #include "guessedvalue.h"
+#include "installplan.h"
 #include "ipluginlist.h"
 
 #include <QDialog>
@@ -29,12 +34,13 @@ along with Mod Organizer.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMetaType>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 
 #include <functional>
+#include <memory>
 #include <vector>
 
 class QAbstractButton;
-class QXmlStreamReader;
 
 namespace Ui {
 class FomodInstallerDialog;
@@ -44,125 +50,14 @@ namespace MOBase {
  class IOrganizer;
 }
 
-class ValueCondition;
-class ConditionFlag;
-class SubCondition;
-class FileCondition;
-class VersionCondition;
-
-class XmlReader;
-
-class IConditionTester {
-public:
-  virtual bool testCondition(int maxIndex, const ValueCondition *condition) const = 0;
-  virtual bool testCondition(int maxIndex, const ConditionFlag *condition) const = 0;
-  virtual bool testCondition(int maxIndex, const SubCondition *condition) const = 0;
-  virtual bool testCondition(int maxIndex, const FileCondition *condition) const = 0;
-  virtual bool testCondition(int maxIndex, const VersionCondition *condition) const = 0;
-};
-
-
-enum ConditionOperator {
-  OP_AND,
-  OP_OR
-};
-
-class Condition {
-public:
-  Condition() { }
-  virtual bool test(int maxIndex, const IConditionTester *tester) const = 0;
-private:
-  Condition &operator=(const Condition&) = delete;
-};
-
-class ConditionFlag : public Condition {
-public:
-  ConditionFlag() : Condition(), m_Name(), m_Value() {}
-  ConditionFlag(const QString &name, const QString &value) : Condition(), m_Name(name), m_Value(value) { }
-  virtual bool test(int maxIndex, const IConditionTester *tester) const { return tester->testCondition(maxIndex, this); }
-  QString m_Name;
-  QString m_Value;
-};
-Q_DECLARE_METATYPE(ConditionFlag)
-
-class ValueCondition : public Condition {
-public:
-  ValueCondition() : Condition(), m_Name(), m_Value() {}
-  ValueCondition(const QString &name, const QString &value) : Condition(), m_Name(name), m_Value(value) { }
-  virtual bool test(int maxIndex, const IConditionTester *tester) const { return tester->testCondition(maxIndex, this); }
-  QString m_Name;
-  QString m_Value;
-};
-Q_DECLARE_METATYPE(ValueCondition)
-
-class FileCondition : public Condition {
-public:
-  FileCondition() : Condition(), m_File(), m_State() {}
-  FileCondition(const QString &file, const QString &state) : Condition(), m_File(file), m_State(state) {}
-  virtual bool test(int maxIndex, const IConditionTester *tester) const { return tester->testCondition(maxIndex, this); }
-  QString m_File;
-  QString m_State;
-};
-Q_DECLARE_METATYPE(FileCondition)
-
-class SubCondition : public Condition {
-public:
-  virtual bool test(int maxIndex, const IConditionTester *tester) const { return tester->testCondition(maxIndex, this); }
-  ConditionOperator m_Operator;
-  std::vector<Condition*> m_Conditions;
-};
-Q_DECLARE_METATYPE(SubCondition)
-
-class VersionCondition : public Condition {
-public:
-  enum Type { v_Game, v_FOMM, v_FOSE };
-  VersionCondition() : Condition(), m_Type(), m_RequiredVersion() {}
-  VersionCondition(Type type, const QString &requiredVersion) : Condition(), m_Type(type), m_RequiredVersion(requiredVersion) { }
-  virtual bool test(int maxIndex, const IConditionTester *tester) const { return tester->testCondition(maxIndex, this); }
-  Type m_Type;
-  QString m_RequiredVersion;
-};
-Q_DECLARE_METATYPE(VersionCondition)
-
-
-class FileDescriptor : public QObject {
-  Q_OBJECT
-public:
-  FileDescriptor(QObject *parent)
-    : QObject(parent), m_Source(), m_Destination(), m_Priority(0), m_IsFolder(false), m_AlwaysInstall(false),
-      m_InstallIfUsable(false),
-      m_FileSystemItemSequence(0)
-  {}
-
-  FileDescriptor(const FileDescriptor &reference)
-    : QObject(reference.parent()), m_Source(reference.m_Source), m_Destination(reference.m_Destination),
-      m_Priority(reference.m_Priority), m_IsFolder(reference.m_IsFolder), m_AlwaysInstall(reference.m_AlwaysInstall),
-      m_InstallIfUsable(reference.m_InstallIfUsable),
-      m_FileSystemItemSequence(reference.m_FileSystemItemSequence)
-  {}
-
-  QString m_Source;
-  QString m_Destination;
-  int m_Priority;
-  bool m_IsFolder;
-  bool m_AlwaysInstall;
-  bool m_InstallIfUsable;
-  int m_FileSystemItemSequence;
-private:
-  FileDescriptor &operator=(const FileDescriptor&);
-};
-
-Q_DECLARE_METATYPE(FileDescriptor*)
-
-
-class FomodInstallerDialog : public QDialog, public IConditionTester
+class FomodInstallerDialog : public QDialog
 {
   Q_OBJECT
 
 public:
   explicit FomodInstallerDialog(const MOBase::GuessedValue<QString> &modName,
                                 const QString &fomodPath,
-                                const std::function<MOBase::IPluginList::PluginStates (const QString &)> &fileCheck,
+                                const std::function<std::vector<MOBase::IPluginList::PluginStates> (const QStringList &)> &fileCheck,
                                 QWidget *parent = 0);
   ~FomodInstallerDialog();
 
@@ -203,8 +98,27 @@ public:
    **/
   MOBase::DirectoryTree *updateTree(MOBase::DirectoryTree *tree);
 
+  /**
+   * @return the files to install for the current selection
+   */
+  InstallPlan installPlan() const;
+
+  /**
+   * @brief create the tree of files to install from a plan. The same caveats as for
+   *        updateTree apply, this is what updateTree does with the plan of the current
+   *        selection
+   */
+  MOBase::DirectoryTree *applyPlan(const InstallPlan &plan, MOBase::DirectoryTree *tree);
+
   bool hasOptions();
 
+  /**
+   * @brief look up the state of all files the fomod depends on again. Required if the plugin
+   *        list changed while the dialog is open, otherwise the states are only determined
+   *        once after reading the ModuleConfig.xml
+   */
+  void refreshFileStates();
+
 protected:
 
   virtual bool eventFilter(QObject *object, QEvent *event);
@@ -226,136 +140,93 @@ private slots:
 
 private:
 
-  enum ItemOrder {
-    ORDER_ASCENDING,
-    ORDER_DESCENDING,
-    ORDER_EXPLICIT
-  };
-
-//So I can make GroupType and PluginTypeInfo into QVariants
-public:
-  enum GroupType {
-    TYPE_SELECTATLEASTONE,
-    TYPE_SELECTATMOSTONE,
-    TYPE_SELECTEXACTLYONE,
-    TYPE_SELECTANY,
-    TYPE_SELECTALL
-  };
+  //Priority of the operation that installed each file of the archive, by leaf index.
+  //Only used to warn about files overwriting others of the same priority
+  typedef std::vector<int> LeafPriorities;
+  static const int NO_PRIORITY;
 
-  enum PluginType {
-    TYPE_REQUIRED,
-    TYPE_RECOMMENDED,
-    TYPE_OPTIONAL,
-    TYPE_NOTUSABLE,
-    TYPE_COULDBEUSABLE
+  enum Visibility {
+    VISIBILITY_UNKNOWN,
+    VISIBILITY_VISIBLE,
+    VISIBILITY_HIDDEN
   };
 
-  struct DependencyPattern {
-    PluginType type;
-    SubCondition condition;
+  // a plugin that can be selected, identified by its position in the document.
+  // Buttons only store the index of their option in m_Options
+  struct Option {
+    int step;
+    int group;
+    int plugin;
   };
 
-  typedef std::vector<DependencyPattern> DependencyPatternList;
-
-  struct PluginTypeInfo
-  {
-    PluginType m_DefaultType;
-    DependencyPatternList m_DependencyPatterns;
+  // widgets only exist for the step currently displayed. For all other steps
+  // this is what's needed to recreate them
+  struct StepState {
+    // the step to return to with the "back" button, -1 if unknown
+    int previous;
+    // for each group, whether each plugin is checked
+    std::vector<std::vector<bool>> checked;
   };
 
 private:
-  typedef std::vector<FileDescriptor*> FileDescriptorList;
-  typedef std::vector<ConditionFlag> ConditionFlagList;
-
-  struct Plugin {
-    QString m_Name;
-    QString m_Description;
-    QString m_ImagePath;
-    PluginTypeInfo m_PluginTypeInfo;
-    ConditionFlagList m_ConditionFlags;
-    FileDescriptorList m_Files;
-  };
-
-  struct ConditionalInstall {
-    SubCondition m_Condition;
-    FileDescriptorList m_Files;
-  };
 
-  struct LeafInfo {
-    int priority;
-    QString path;
-  };
-
-  typedef std::map<int, LeafInfo> Leaves;
-
-private:
-
-  QString readContent(QXmlStreamReader &reader);
   void readInfoXml();
   void readModuleConfigXml();
-  void parseInfo(QXmlStreamReader &data);
 
   void updateNameEdit();
 
   static int bomOffset(const QByteArray &buffer);
-  static ItemOrder getItemOrder(const QString &orderString);
-  static GroupType getGroupType(const QString &typeString);
-  static PluginType getPluginType(const QString &typeString);
-  static bool byPriority(const FileDescriptor *LHS, const FileDescriptor *RHS);
 
   PluginType getPluginDependencyType(int page, PluginTypeInfo const &info) const;
 
-  bool copyFileIterator(MOBase::DirectoryTree *sourceTree, MOBase::DirectoryTree *destinationTree,
-                        const FileDescriptor *descriptor,
-                        Leaves *leaves, MOBase::DirectoryTree::Overwrites *overwrites);
-
-  typedef void (FomodInstallerDialog::*TagProcessor)(XmlReader &reader);
-  void processXmlTag(XmlReader &reader, char const *tag, TagProcessor func);
-
-  void readFileList(XmlReader &reader, FileDescriptorList &fileList);
-  void readDependencyPattern(XmlReader &reader, DependencyPattern &pattern);
-  void readDependencyPatternList(XmlReader &reader, DependencyPatternList &patterns);
-  void readDependencyPluginType(XmlReader &reader, PluginTypeInfo &info);
-  void readPluginType(XmlReader &reader, Plugin &plugin);
-  void readConditionFlagList(XmlReader &reader, ConditionFlagList &condflags);
-  FomodInstallerDialog::Plugin readPlugin(XmlReader &reader);
-  void readPluginList(XmlReader &reader, QString const &groupName, GroupType &groupType, QLayout *layout);
-  void readGroup(XmlReader &reader, QLayout *layout);
-  void readGroupList(XmlReader &reader, QLayout *layout);
-  QGroupBox *readInstallStep(XmlReader &reader);
-  void readCompositeDependency(XmlReader &reader, SubCondition &conditional);
-  ConditionalInstall readConditionalInstallPattern(XmlReader &reader);
-  void readConditionalFilePatternList(XmlReader &reader);
-  void readConditionalFileInstallList(XmlReader &reader);
-  void readStepList(XmlReader &reader);
-  void readModuleConfiguration(XmlReader &reader);
-  void parseModuleConfig(XmlReader &data);
-  void highlightControl(QAbstractButton *button);
-
-  bool testCondition(int maxIndex, const QString &flag, const QString &value) const;
-  virtual bool testCondition(int maxIndex, const ValueCondition *condition) const;
-  virtual bool testCondition(int maxIndex, const ConditionFlag *condition) const;
-  virtual bool testCondition(int maxIndex, const SubCondition *condition) const;
-  virtual bool testCondition(int maxIndex, const FileCondition *condition) const;
-  virtual bool testCondition(int maxIndex, const VersionCondition *condition) const;
+  bool copyFileIterator(DirectoryIndex *sourceIndex, DirectoryIndex *destinationIndex,
+                        const InstallPlan &plan, const InstallPlan::Operation &operation,
+                        LeafPriorities *priorities, MOBase::DirectoryTree::Overwrites *overwrites);
+
+  void createPluginControls(const Group &group, int firstOption, const std::vector<bool> &checked,
+                            QLayout *layout);
+  void createGroup(const Group &group, int firstOption, const std::vector<bool> &checked, QLayout *layout);
+  QGroupBox *createStepPage(int index);
+  void initSteps();
+  void showStep(int index);
+  void saveCurrentPage();
+  CompiledConditions::FlagValueList pageFlags(int page) const;
+  const Plugin &optionPlugin(int option) const;
+  void highlightControl(int option);
+
+  bool testCondition(int maxIndex, const SubCondition &condition) const;
+
+  //Flag test used when evaluating compiled conditions
+  friend class CompiledConditions;
+  bool testFlag(int maxIndex, int flag, int value) const;
+  void readVersions();
+  void compileConditions();
   bool testVisible(int pageIndex) const;
+  void invalidateVisibility();
   bool nextPage();
   void activateCurrentPage();
   void moveTree(MOBase::DirectoryTree::Node *target, MOBase::DirectoryTree::Node *source, MOBase::DirectoryTree::Overwrites *overwrites);
-  MOBase::DirectoryTree::Node *findNode(MOBase::DirectoryTree::Node *node, const QString &path, bool create);
-  void copyLeaf(MOBase::DirectoryTree::Node *sourceTree, const QString &sourcePath,
-                MOBase::DirectoryTree::Node *destinationTree, const QString &destinationPath,
-                MOBase::DirectoryTree::Overwrites *overwrites, Leaves *leaves, int pri);
-
-  static void FomodInstallerDialog::applyPriority(Leaves *leaves, MOBase::DirectoryTree::Node *node, int priority);
+  MOBase::DirectoryTree::Node *findNode(DirectoryIndex *index, const InstallPlan &plan,
+                                        const DescriptorPath &path, bool create);
+  void copyLeaf(DirectoryIndex *sourceIndex, MOBase::DirectoryTree::Node *sourceNode,
+                const InstallPlan &plan, const DescriptorPath &sourcePath,
+                MOBase::DirectoryTree::Node *destinationNode, const QString &destinationName,
+                MOBase::DirectoryTree::Overwrites *overwrites, LeafPriorities *priorities, int priority);
+
+  static void setPriority(LeafPriorities *priorities, int leaf, int priority);
+  static void applyPriority(LeafPriorities *priorities, MOBase::DirectoryTree::Node *node, int priority);
+  static void warnSamePriority(MOBase::DirectoryTree::Node *archive, MOBase::DirectoryTree *tree,
+                               const LeafPriorities &priorities,
+                               const MOBase::DirectoryTree::Overwrites &overwrites);
 
   static QString toString(MOBase::IPluginList::PluginStates state);
 
   //Set the 'next' button to display 'next' or 'install'
   void updateNextbtnText();
 
-  //Display the current page calculating all the button enables/disables
-  void displayCurrentPage();
+  //Display the current page calculating all the button enables/disables.
+  //Unless applyDefaults is set the current selection is kept as is
+  void displayCurrentPage(bool applyDefaults = true);
 
 private:
 
@@ -368,15 +239,33 @@ private:
   QString m_FomodPath;
   bool m_Manual;
 
-  FileDescriptorList m_RequiredFiles;
-  std::vector<ConditionalInstall> m_ConditionalInstalls;
+  std::unique_ptr<FomodDocument> m_Document;
   std::vector<bool> m_PageVisible;
 
-  std::function<MOBase::IPluginList::PluginStates (const QString&)> m_FileCheck;
-
-  //Because NMM maintains the sequence from the xml when dealing with things with
-  //the same priority, we have to as well. This is moderately hacky.
-  int m_FileSystemItemSequence;
+  CompiledConditions m_Conditions;
+  //File states and versions, the conditions are simplified with these
+  CompiledConditions::Session m_Session;
+
+  std::vector<StepState> m_StepStates;
+  //Interned condition flags set by each plugin, by step, group and plugin
+  std::vector<std::vector<std::vector<CompiledConditions::FlagValueList>>> m_PluginFlags;
+  //Flags set by the pages entered so far
+  FlagState m_FlagState;
+  //Visibility of the steps after the current one, only reevaluated once a flag their
+  //condition reads has changed
+  mutable std::vector<Visibility> m_VisibilityCache;
+  //For each flag the steps whose visibility depends on it
+  std::vector<std::vector<int>> m_FlagDependents;
+  int m_CurrentStep;
+  //All plugins of the document and for each step and group the index of its first one
+  std::vector<Option> m_Options;
+  std::vector<std::vector<int>> m_FirstOptions;
+  //Controls on the current page, by group
+  std::vector<std::vector<QAbstractButton*>> m_PageControls;
+  //The "None" button of each group on the current page or a null pointer
+  std::vector<QAbstractButton*> m_NoneButtons;
+
+  std::function<std::vector<MOBase::IPluginList::PluginStates> (const QStringList&)> m_FileCheck;
 
   //So I can find out game info (I hope)
   MOBase::IOrganizer *m_MoInfo;
@@ -386,7 +275,4 @@ private:
 
 };
 
-Q_DECLARE_METATYPE(FomodInstallerDialog::GroupType)
-Q_DECLARE_METATYPE(FomodInstallerDialog::PluginTypeInfo)
-
 #endif // FOMODINSTALLERDIALOG_H
@@ -0,0 +1,732 @@
+#include "fomodparser.h"
+
+#include "encodingsniffer.h"
+#include "fomodcache.h"
+#include "utility.h"
+#include "xmlreader.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <algorithm>
+
+using MOBase::MyException;
+
+
+namespace {
+
+bool PluginsAscending(const Plugin &LHS, const Plugin &RHS)
+{
+  return LHS.m_Name < RHS.m_Name;
+}
+
+
+bool PluginsDescending(const Plugin &LHS, const Plugin &RHS)
+{
+  return LHS.m_Name > RHS.m_Name;
+}
+
+
+bool StepsAscending(const InstallStep &LHS, const InstallStep &RHS)
+{
+  return LHS.m_Name < RHS.m_Name;
+}
+
+
+bool StepsDescending(const InstallStep &LHS, const InstallStep &RHS)
+{
+  return LHS.m_Name > RHS.m_Name;
+}
+
+
+// maps the whole file into memory. The returned array refers to the mapping so it's only
+// valid as long as the file stays open. Falls back to reading the file if it can't be mapped
+QByteArray mapFile(QFile &file)
+{
+  qint64 size = file.size();
+  if (size > 0) {
+    uchar *data = file.map(0, size);
+    if (data != nullptr) {
+      return QByteArray::fromRawData(reinterpret_cast<const char*>(data), static_cast<int>(size));
+    }
+  }
+  return file.readAll();
+}
+
+
+// nmm's xml parser is less strict than the one from qt and allows files with
+// wrong encoding in the header. Being strict here would be bad user experience.
+// The document is parsed as is first unless the declared encoding doesn't match
+// the content, in which case that attempt would fail anyway. If the strict attempt
+// is skipped or fails the document is decoded with the encoding of its content
+std::unique_ptr<XmlReader> createReader(const QByteArray &data, const EncodingSniffer &sniffer, bool strict)
+{
+  if (strict) {
+    return std::unique_ptr<XmlReader>(new XmlReader(data));
+  } else {
+    qDebug("declared encoding \"%s\", interpreting as %s",
+           sniffer.declaredEncoding().constData(), sniffer.codecName());
+    return std::unique_ptr<XmlReader>(new XmlReader(sniffer.decode()));
+  }
+}
+
+}
+
+
+std::unique_ptr<FomodDocument> FomodParser::readModuleConfig(const QString &fileName, const FomodCache *cache)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    throw MyException(tr("ModuleConfig.xml missing"));
+  }
+  // the document is parsed straight from the mapping, the file has to stay open until then
+  QByteArray data = mapFile(file);
+
+  QByteArray cacheKey;
+  if (cache != nullptr) {
+    cacheKey = FomodCache::key(data);
+    std::unique_ptr<FomodDocument> document = cache->load(cacheKey);
+    if (document.get() != nullptr) {
+      qDebug("using cached ModuleConfig.xml");
+      return document;
+    }
+  }
+
+  std::unique_ptr<FomodDocument> document = parseModuleConfigData(data);
+  if ((document.get() != nullptr) && (cache != nullptr)) {
+    cache->store(cacheKey, *document);
+  }
+  return document;
+}
+
+
+std::unique_ptr<FomodDocument> FomodParser::parseModuleConfigData(const QByteArray &data)
+{
+  EncodingSniffer sniffer(data.constData(), static_cast<std::size_t>(data.size()));
+  for (bool strict = sniffer.declarationMatches(); ; strict = false) {
+    std::unique_ptr<FomodDocument> document(new FomodDocument);
+    std::unique_ptr<XmlReader> reader = createReader(data, sniffer, strict);
+    try {
+      FomodParser parser(*document);
+      parser.parseModuleConfig(*reader);
+    } catch (const XmlParseError &e) {
+      if (strict) {
+        qDebug("failed to parse ModuleConfig.xml as declared: %s", e.what());
+        continue;
+      }
+      qWarning("failed to parse ModuleConfig.xml: %s", e.what());
+      document.reset();
+    }
+    if (!reader->diagnostics().empty()) {
+      qWarning("ModuleConfig.xml: %s", qPrintable(reader->diagnostics().summary()));
+    }
+    return document;
+  }
+}
+
+
+bool FomodParser::readInfo(const QString &fileName, FomodInfo &info)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return true;
+  }
+
+  QByteArray data = mapFile(file);
+  EncodingSniffer sniffer(data.constData(), static_cast<std::size_t>(data.size()));
+  for (bool strict = sniffer.declarationMatches(); ; strict = false) {
+    try {
+      FomodInfo result;
+      std::unique_ptr<XmlReader> reader = createReader(data, sniffer, strict);
+      parseInfo(*reader, result);
+      info = result;
+      return true;
+    } catch (const XmlParseError &e) {
+      if (strict) {
+        qDebug("failed to parse info.xml as declared: %s", e.what());
+        continue;
+      }
+      qWarning("failed to parse info.xml: %s", e.what());
+      return false;
+    }
+  }
+}
+
+
+QString FomodParser::readContent(QXmlStreamReader &reader)
+{
+  if (reader.readNext() == XmlReader::Characters) {
+    return reader.text().toString();
+  } else {
+    return QString();
+  }
+}
+
+
+void FomodParser::parseInfo(QXmlStreamReader &reader, FomodInfo &info)
+{
+  while (!reader.atEnd()) {
+    switch (reader.readNext()) {
+      case QXmlStreamReader::StartElement: {
+        if (reader.name() == "Name") {
+          info.m_Name = readContent(reader);
+        } else if (reader.name() == "Author") {
+          info.m_Author = readContent(reader);
+        } else if (reader.name() == "Version") {
+          info.m_Version = readContent(reader);
+        } else if (reader.name() == "Id") {
+          info.m_ModID = readContent(reader).toInt();
+        } else if (reader.name() == "Website") {
+          info.m_Website = readContent(reader);
+        }
+      } break;
+      default: {} break;
+    }
+  }
+  if (reader.hasError()) {
+    throw XmlParseError(QString("%1 in line %2").arg(reader.errorString()).arg(reader.lineNumber()));
+  }
+}
+
+
+FomodParser::FomodParser(FomodDocument &document)
+  : m_Document(document), m_FileSystemItemSequence(0)
+{
+}
+
+
+ItemOrder FomodParser::getItemOrder(const QStringRef &orderString)
+{
+  if (orderString == QLatin1String("Ascending")) {
+    return ORDER_ASCENDING;
+  } else if (orderString == QLatin1String("Descending")) {
+    return ORDER_DESCENDING;
+  } else if (orderString == QLatin1String("Explicit")) {
+    return ORDER_EXPLICIT;
+  } else {
+    throw MyException(tr("unsupported order type %1").arg(orderString.toString()));
+  }
+}
+
+
+GroupType FomodParser::getGroupType(const QStringRef &typeString)
+{
+  if (typeString == QLatin1String("SelectAtLeastOne")) {
+    return TYPE_SELECTATLEASTONE;
+  } else if (typeString == QLatin1String("SelectAtMostOne")) {
+    return TYPE_SELECTATMOSTONE;
+  } else if (typeString == QLatin1String("SelectExactlyOne")) {
+    return TYPE_SELECTEXACTLYONE;
+  } else if (typeString == QLatin1String("SelectAny")) {
+    return TYPE_SELECTANY;
+  } else if (typeString == QLatin1String("SelectAll")) {
+    return TYPE_SELECTALL;
+  } else {
+    throw MyException(tr("unsupported group type %1").arg(typeString.toString()));
+  }
+}
+
+
+PluginType FomodParser::getPluginType(const QStringRef &typeString)
+{
+  if (typeString == QLatin1String("Required")) {
+    return TYPE_REQUIRED;
+  } else if (typeString == QLatin1String("Optional")) {
+    return TYPE_OPTIONAL;
+  } else if (typeString == QLatin1String("Recommended")) {
+    return TYPE_RECOMMENDED;
+  } else if (typeString == QLatin1String("NotUsable")) {
+    return TYPE_NOTUSABLE;
+  } else if (typeString == QLatin1String("CouldBeUsable")) {
+    return TYPE_COULDBEUSABLE;
+  } else {
+    qCritical("invalid plugin type %s", typeString.toUtf8().constData());
+    return TYPE_OPTIONAL;
+  }
+}
+
+
+void FomodParser::readFileList(XmlReader &reader, FileDescriptorList &fileList)
+{
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_FOLDER:
+      case XmlReader::TAG_FILE: {
+        //This is a horrendous hack. It doesn't make sense to specify an empty source folder name,
+        //as it would require you to copy everything including the fomod directory. However, people
+        //have been known to write entries like <folder source="" destination=""/> in order to
+        //achieve an option that does nothing. Are groups and buttons that hard?
+        //An empty source file is very probably a serious error but given people do the above, I'm
+        //assuming that they probably assume <file source="" destination=""/> will work the same,
+        //so I'm not differentiating.
+        //Similarly, I'm not checking for the destination if the source is blank. Why'd you want to
+        //copy the fomod directory on an install?
+        if (reader.attribute("source").isEmpty()) {
+          reader.warn(ParseDiagnostics::DIAG_EMPTY_SOURCE);
+        } else {
+          FileDescriptor *file = m_Document.createFileDescriptor();
+          QString source = reader.attribute("source").toString();
+          QString destination = reader.hasAttribute("destination") ? reader.attribute("destination").toString()
+                                                                   : source;
+          file->m_Source = m_Document.addString(source);
+          file->m_Destination = m_Document.addString(destination);
+          file->m_Priority = reader.hasAttribute("priority") ? reader.attribute("priority").toInt()
+                                                             : 0;
+          file->m_FileSystemItemSequence = ++m_FileSystemItemSequence;
+          file->m_IsFolder = reader.token() == XmlReader::TAG_FOLDER;
+          file->m_SourcePath = m_Document.addPath(source, file->m_IsFolder);
+          file->m_DestinationPath = m_Document.addPath(destination, file->m_IsFolder);
+          file->m_InstallIfUsable = reader.attribute("installIfUsable") == QLatin1String("true");
+          file->m_AlwaysInstall = reader.attribute("alwaysInstall") == QLatin1String("true");
+
+          fileList.push_back(file);
+        }
+        reader.finishedElement();
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+void FomodParser::readDependencyPattern(XmlReader &reader, DependencyPattern &pattern)
+{
+  //sequence
+  //  dependency
+  //  type
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_DEPENDENCIES: {
+        readCompositeDependency(reader, pattern.condition);
+      } break;
+      case XmlReader::TAG_TYPE: {
+        pattern.type = getPluginType(reader.attribute("name"));
+        reader.finishedElement();
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+void FomodParser::readDependencyPatternList(XmlReader &reader, DependencyPatternList &patterns)
+{
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_PATTERN) {
+      DependencyPattern pattern;
+      readDependencyPattern(reader, pattern);
+      patterns.push_back(pattern);
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+void FomodParser::readDependencyPluginType(XmlReader &reader, PluginTypeInfo &info)
+{
+  //sequence
+  // defaultType
+  // patterns
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_DEFAULTTYPE: {
+        info.m_DefaultType = getPluginType(reader.attribute("name"));
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_PATTERNS: {
+        readDependencyPatternList(reader, info.m_DependencyPatterns);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+void FomodParser::readPluginType(XmlReader &reader, Plugin &plugin)
+{
+  //Have a choice here of precisely one of 'type' or 'dependencytype', so this is
+  //not strictly necessary
+  plugin.m_PluginTypeInfo.m_DefaultType = TYPE_OPTIONAL;
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_TYPE: {
+        plugin.m_PluginTypeInfo.m_DefaultType = getPluginType(reader.attribute("name"));
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_DEPENDENCYTYPE: {
+        readDependencyPluginType(reader, plugin.m_PluginTypeInfo);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+
+void FomodParser::readConditionFlagList(XmlReader &reader, ConditionFlagList &condflags)
+{
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_FLAG) {
+      QString name = reader.attribute("name").toString();
+      QString content = reader.getText();
+      condflags.push_back(ConditionFlag(name, content));
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+
+Plugin FomodParser::readPlugin(XmlReader &reader)
+{
+  Plugin result;
+  result.m_Name = reader.attribute("name").toString();
+  result.m_PluginTypeInfo.m_DefaultType = TYPE_OPTIONAL;
+
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_DESCRIPTION: {
+        result.m_Description = reader.getText().trimmed();
+      } break;
+      case XmlReader::TAG_IMAGE: {
+        result.m_ImagePath = reader.attribute("path").toString();
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_FILES: {
+        readFileList(reader, result.m_Files);
+      } break;
+      case XmlReader::TAG_CONDITIONFLAGS: {
+        readConditionFlagList(reader, result.m_ConditionFlags);
+      } break;
+      case XmlReader::TAG_TYPEDESCRIPTOR: {
+        readPluginType(reader, result);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+
+  //I (TRT) am not quite sure why this sort is done here. It is done again
+  //when the files have been selected before installing them, which seems
+  //a more appropriate place.
+  std::sort(result.m_Files.begin(), result.m_Files.end(), FileDescriptor::byPriority);
+
+  return result;
+}
+
+
+void FomodParser::readPluginList(XmlReader &reader, Group &group)
+{
+  ItemOrder pluginOrder = reader.hasAttribute("order") ? getItemOrder(reader.attribute("order"))
+                                                                    : ORDER_ASCENDING;
+
+  // Read in all the plugins so we can check if the author is using "atmost" or "exactly",
+  // and correct as appropriate
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_PLUGIN) {
+      group.m_Plugins.push_back(readPlugin(reader));
+    } else {
+      reader.unexpected();
+    }
+  }
+
+  //This is somewhat of a hack. If the author has specified only 1 plugin and the
+  //group type is SELECTATLEASTONE or SELECTEXACTLYONE, then that plugin has to
+  //be selected. A note: This doesn't check for if somebody has defined a single
+  //plugin group with one of the above types, and then made the plugin unselectable.
+  //They deserve what they get.
+  //Similarly, if they've specfied SELECTATMOSTONE, we might as well give them
+  //a checkbox
+  if (group.m_Plugins.size() == 1) {
+    switch (group.m_Type) {
+      case TYPE_SELECTATLEASTONE: {
+        qWarning() << "Plugin " << group.m_Plugins[0].m_Name << " is the only plugin specified in group " <<
+                        group.m_Name << " which requires selection of at least one plugin";
+        group.m_Type = TYPE_SELECTALL;
+      } break;
+      case TYPE_SELECTEXACTLYONE: {
+        qWarning() << "Plugin " << group.m_Plugins[0].m_Name << " is the only plugin specified in group " <<
+                        group.m_Name << " which requires selection of exactly one plugin";
+        group.m_Type = TYPE_SELECTALL;
+      } break;
+      case TYPE_SELECTATMOSTONE: {
+        qWarning() << "Plugin " << group.m_Plugins[0].m_Name << " is the only plugin specified in group " <<
+                        group.m_Name << " which permits selection of at most one plugin";
+        group.m_Type = TYPE_SELECTANY;
+      } break;
+    }
+  }
+
+  if (pluginOrder == ORDER_ASCENDING) {
+    std::sort(group.m_Plugins.begin(), group.m_Plugins.end(), PluginsAscending);
+  } else if (pluginOrder == ORDER_DESCENDING) {
+    std::sort(group.m_Plugins.begin(), group.m_Plugins.end(), PluginsDescending);
+  }
+}
+
+
+void FomodParser::readGroup(XmlReader &reader, Group &group)
+{
+  group.m_Name = reader.attribute("name").toString();
+  group.m_Type = getGroupType(reader.attribute("type"));
+
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_PLUGINS) {
+      readPluginList(reader, group);
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+
+void FomodParser::readGroupList(XmlReader &reader, InstallStep &step)
+{
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_GROUP) {
+      step.m_Groups.push_back(Group());
+      readGroup(reader, step.m_Groups.back());
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+void FomodParser::readInstallStep(XmlReader &reader, InstallStep &step)
+{
+  step.m_Name = reader.attribute("name").toString();
+
+  //sequence:
+  //  visible (optional)
+  //  optionalFileGroups
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_VISIBLE: {
+        readCompositeDependency(reader, step.m_Visible);
+      } break;
+      case XmlReader::TAG_OPTIONALFILEGROUPS: {
+        readGroupList(reader, step);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+
+void FomodParser::readStepList(XmlReader &reader)
+{
+  ItemOrder stepOrder = reader.hasAttribute("order") ? getItemOrder(reader.attribute("order"))
+                                                                    : ORDER_ASCENDING;
+
+  std::vector<InstallStep> &steps = m_Document.m_Steps;
+
+  //sequence installStep (1 or more)
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_INSTALLSTEP) {
+      steps.push_back(InstallStep());
+      readInstallStep(reader, steps.back());
+    } else {
+      reader.unexpected();
+    }
+  }
+
+  if (stepOrder == ORDER_ASCENDING) {
+    std::sort(steps.begin(), steps.end(), StepsAscending);
+  } else if (stepOrder == ORDER_DESCENDING) {
+    std::sort(steps.begin(), steps.end(), StepsDescending);
+  }
+}
+
+
+void FomodParser::readCompositeDependency(XmlReader &reader, SubCondition &conditional)
+{
+  conditional.m_Operator = OP_AND;
+  if (reader.hasAttribute("operator")) {
+    QStringRef dependencyOperator = reader.attribute("operator");
+    if (dependencyOperator == QLatin1String("Or")) {
+      conditional.m_Operator = OP_OR;
+    } else if (dependencyOperator != QLatin1String("And")) {
+      reader.warn(ParseDiagnostics::DIAG_INVALID_OPERATOR);
+    } // OP_AND is the default, set at the beginning of the function
+  }
+
+  //Operands are collected here and stored in the document in one block once
+  //they are complete. Nested conditions store theirs first
+  std::vector<Condition> operands;
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_FILEDEPENDENCY: {
+        operands.push_back(Condition::file(m_Document.addString(reader.attribute("file").toString()),
+                                           m_Document.addString(reader.attribute("state").toString())));
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_FLAGDEPENDENCY: {
+        operands.push_back(Condition::flag(m_Document.addString(reader.attribute("flag").toString()),
+                                           m_Document.addString(reader.attribute("value").toString())));
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_GAMEDEPENDENCY: {
+        operands.push_back(readVersionDependency(reader, Condition::VERSION_GAME));
+      } break;
+      case XmlReader::TAG_FOMMDEPENDENCY: {
+        operands.push_back(readVersionDependency(reader, Condition::VERSION_FOMM));
+      } break;
+      case XmlReader::TAG_FOSEDEPENDENCY: {
+        operands.push_back(readVersionDependency(reader, Condition::VERSION_FOSE));
+      } break;
+      case XmlReader::TAG_DEPENDENCIES: {
+        SubCondition nested;
+        readCompositeDependency(reader, nested);
+        operands.push_back(Condition::sub(nested));
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+  if (operands.empty()) {
+    reader.warn(ParseDiagnostics::DIAG_EMPTY_CONDITION);
+  }
+  conditional.m_First = m_Document.addConditions(operands);
+  conditional.m_Count = static_cast<int>(operands.size());
+}
+
+
+Condition FomodParser::readVersionDependency(XmlReader &reader, Condition::VersionType type)
+{
+  QString version = reader.attribute("version").toString();
+  reader.finishedElement();
+  return Condition::version(type, m_Document.addString(version), version);
+}
+
+
+ConditionalInstall FomodParser::readConditionalInstallPattern(XmlReader &reader)
+{
+  ConditionalInstall result;
+  result.m_Condition.m_Operator = OP_AND;
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_DEPENDENCIES: {
+        readCompositeDependency(reader, result.m_Condition);
+      } break;
+      case XmlReader::TAG_FILES: {
+        readFileList(reader, result.m_Files);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+  return result;
+}
+
+void FomodParser::readConditionalFilePatternList(XmlReader &reader)
+{
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_PATTERN) {
+      m_Document.m_ConditionalInstalls.push_back(readConditionalInstallPattern(reader));
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+void FomodParser::readConditionalFileInstallList(XmlReader &reader)
+{
+  XmlReader::Tag const self = reader.token();
+  //Technically there should be only one but it's easier to write like this
+  while (reader.getNextElement(self)) {
+    if (reader.token() == XmlReader::TAG_PATTERNS) {
+      readConditionalFilePatternList(reader);
+    } else {
+      reader.unexpected();
+    }
+  }
+}
+
+
+void FomodParser::readModuleConfiguration(XmlReader &reader)
+{
+  //sequence:
+  //  modulename
+  //  optional - moduleImage
+  //  optional - moduleDependencies
+  //  optional - requiredInstallFiles
+  //  optional - installSteps
+  //  optional - conditionalFileInstalls
+  XmlReader::Tag const self = reader.token();
+  while (reader.getNextElement(self)) {
+    switch (reader.token()) {
+      case XmlReader::TAG_MODULENAME: {
+        m_Document.m_ModuleName = reader.getText();
+        qDebug() << "module name : "  << m_Document.m_ModuleName;
+      } break;
+      case XmlReader::TAG_MODULEIMAGE: {
+        //do something useful with the attributes of this
+        reader.finishedElement();
+      } break;
+      case XmlReader::TAG_MODULEDEPENDENCIES: {
+        //This is tested by the caller once the whole document is available
+        readCompositeDependency(reader, m_Document.m_ModuleDependencies);
+      } break;
+      case XmlReader::TAG_REQUIREDINSTALLFILES: {
+        readFileList(reader, m_Document.m_RequiredFiles);
+      } break;
+      case XmlReader::TAG_INSTALLSTEPS: {
+        readStepList(reader);
+      } break;
+      case XmlReader::TAG_CONDITIONALFILEINSTALLS: {
+        readConditionalFileInstallList(reader);
+      } break;
+      default: {
+        reader.unexpected();
+      } break;
+    }
+  }
+}
+
+void FomodParser::parseModuleConfig(XmlReader &reader)
+{
+  if (reader.readNext() != XmlReader::StartDocument) {
+    throw XmlParseError(QString("Expected document start at line %1").arg(reader.lineNumber()));
+  }
+  processXmlTag(reader, XmlReader::TAG_CONFIG, &FomodParser::readModuleConfiguration);
+  if (reader.readNext() != XmlReader::EndDocument) {
+    throw XmlParseError(QString("Expected document end at line %1").arg(reader.lineNumber()));
+  }
+  if (reader.hasError()) {
+    throw XmlParseError(QString("%1 in line %2").arg(reader.errorString()).arg(reader.lineNumber()));
+  }
+}
+
+
+void FomodParser::processXmlTag(XmlReader &reader, XmlReader::Tag tag, TagProcessor func)
+{
+  if (reader.readNext() == XmlReader::StartElement && reader.token() == tag) {
+    (this->*func)(reader);
+  } else if (! reader.hasError()) {
+    reader.raiseError(QString("Expected %1, got %2").arg(XmlReader::tagName(tag)).arg(reader.name().toString()));
+  }
+}
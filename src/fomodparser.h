@@ -0,0 +1,99 @@
+#ifndef FOMODPARSER_H
+#define FOMODPARSER_H
+
+#include "fomoddocument.h"
+#include "xmlreader.h"
+
+#include <QCoreApplication>
+#include <QString>
+
+#include <memory>
+#include <stdexcept>
+
+class FomodCache;
+class QXmlStreamReader;
+
+struct XmlParseError : std::runtime_error {
+  XmlParseError(const QString &message)
+    : std::runtime_error(message.toUtf8().constData()) {}
+};
+
+/**
+ * @brief reads fomod/ModuleConfig.xml and fomod/info.xml into a FomodDocument / FomodInfo.
+ *        This has no dependency on widgets and may be used without the installer dialog
+ */
+class FomodParser
+{
+  Q_DECLARE_TR_FUNCTIONS(FomodParser)
+
+public:
+
+  /**
+   * @brief read a ModuleConfig.xml, working around broken encodings
+   * @param fileName path of the file to read
+   * @param cache if not null, the document is taken from this cache if possible. Freshly
+   *              parsed documents are added to the cache
+   * @return the parsed document or a null pointer if the file couldn't be parsed
+   * @throw MyException if the file can't be opened
+   */
+  static std::unique_ptr<FomodDocument> readModuleConfig(const QString &fileName, const FomodCache *cache = nullptr);
+
+  /**
+   * @brief read an info.xml, working around broken encodings
+   * @param fileName path of the file to read
+   * @param info receives the package information. Unchanged if the file doesn't exist
+   * @return false if the file exists but couldn't be parsed
+   */
+  static bool readInfo(const QString &fileName, FomodInfo &info);
+
+  static void parseInfo(QXmlStreamReader &reader, FomodInfo &info);
+
+public:
+
+  explicit FomodParser(FomodDocument &document);
+
+  void parseModuleConfig(XmlReader &reader);
+
+private:
+
+  static std::unique_ptr<FomodDocument> parseModuleConfigData(const QByteArray &data);
+
+  static QString readContent(QXmlStreamReader &reader);
+
+  static ItemOrder getItemOrder(const QStringRef &orderString);
+  static GroupType getGroupType(const QStringRef &typeString);
+  static PluginType getPluginType(const QStringRef &typeString);
+
+  typedef void (FomodParser::*TagProcessor)(XmlReader &reader);
+  void processXmlTag(XmlReader &reader, XmlReader::Tag tag, TagProcessor func);
+
+  void readFileList(XmlReader &reader, FileDescriptorList &fileList);
+  void readDependencyPattern(XmlReader &reader, DependencyPattern &pattern);
+  void readDependencyPatternList(XmlReader &reader, DependencyPatternList &patterns);
+  void readDependencyPluginType(XmlReader &reader, PluginTypeInfo &info);
+  void readPluginType(XmlReader &reader, Plugin &plugin);
+  void readConditionFlagList(XmlReader &reader, ConditionFlagList &condflags);
+  Plugin readPlugin(XmlReader &reader);
+  void readPluginList(XmlReader &reader, Group &group);
+  void readGroup(XmlReader &reader, Group &group);
+  void readGroupList(XmlReader &reader, InstallStep &step);
+  void readInstallStep(XmlReader &reader, InstallStep &step);
+  void readCompositeDependency(XmlReader &reader, SubCondition &conditional);
+  Condition readVersionDependency(XmlReader &reader, Condition::VersionType type);
+  ConditionalInstall readConditionalInstallPattern(XmlReader &reader);
+  void readConditionalFilePatternList(XmlReader &reader);
+  void readConditionalFileInstallList(XmlReader &reader);
+  void readStepList(XmlReader &reader);
+  void readModuleConfiguration(XmlReader &reader);
+
+private:
+
+  FomodDocument &m_Document;
+
+  //Because NMM maintains the sequence from the xml when dealing with things with
+  //the same priority, we have to as well. This is moderately hacky.
+  int m_FileSystemItemSequence;
+
+};
+
+#endif // FOMODPARSER_H
@@ -0,0 +1,68 @@
+#include "inactivemodindex.h"
+
+#include <QDir>
+#include <QDirIterator>
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+// the keys of all files in a mod
+QStringList listFiles(const QString &path)
+{
+  QStringList result;
+  QDir base(path);
+  QDirIterator iter(path, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+  while (iter.hasNext()) {
+    result.append(InactiveModIndex::key(base.relativeFilePath(iter.next())));
+  }
+  return result;
+}
+
+// list the files of every taskCount-th mod, starting with the first one
+std::vector<QStringList> listMods(const QStringList &paths, int first, int taskCount)
+{
+  std::vector<QStringList> result;
+  for (int i = first; i < paths.size(); i += taskCount) {
+    result.push_back(listFiles(paths.at(i)));
+  }
+  return result;
+}
+
+}
+
+
+InactiveModIndex::InactiveModIndex(const QStringList &names, const QStringList &paths)
+{
+  // mods are handed out round robin so large mods, which tend to be grouped together
+  // in the list, are spread across the tasks
+  int taskCount = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()),
+                                       paths.size()));
+  std::vector<std::future<std::vector<QStringList>>> tasks;
+  for (int i = 0; i < taskCount; ++i) {
+    tasks.push_back(std::async(std::launch::async, listMods, std::cref(paths), i, taskCount));
+  }
+
+  for (int i = 0; i < taskCount; ++i) {
+    std::vector<QStringList> files = tasks[i].get();
+    for (size_t mod = 0; mod < files.size(); ++mod) {
+      const QString &name = names.at(i + static_cast<int>(mod) * taskCount);
+      for (const QString &file : files[mod]) {
+        m_Files[file].append(name);
+      }
+    }
+  }
+}
+
+QString InactiveModIndex::key(const QString &fileName)
+{
+  QString result = QDir::cleanPath(QDir::fromNativeSeparators(fileName)).toCaseFolded();
+  if (result.startsWith('/')) {
+    result.remove(0, 1);
+  }
+  return result;
+}
@@ -0,0 +1,47 @@
+#ifndef INACTIVEMODINDEX_H
+#define INACTIVEMODINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief index of the files contained in mods that aren't active.
+ *
+ * Used to find dependencies that are installed but disabled. The mod directories are walked
+ * once, in parallel, and file lookups afterwards never touch the disk. Paths are relative to
+ * the mod directory and compared case-insensitively.
+ */
+class InactiveModIndex
+{
+public:
+
+  /**
+   * @brief build the index. This blocks until all mods have been scanned
+   * @param names names of the mods
+   * @param paths absolute paths of the mods, in the same order as names
+   */
+  InactiveModIndex(const QStringList &names, const QStringList &paths);
+
+  /**
+   * @return true if any of the mods contains the file
+   */
+  bool contains(const QString &fileName) const { return m_Files.contains(key(fileName)); }
+
+  /**
+   * @return names of all mods containing the file
+   */
+  QStringList mods(const QString &fileName) const { return m_Files.value(key(fileName)); }
+
+  /**
+   * @return the form of a relative file name used for lookups
+   */
+  static QString key(const QString &fileName);
+
+private:
+
+  QHash<QString, QStringList> m_Files;
+
+};
+
+#endif // INACTIVEMODINDEX_H
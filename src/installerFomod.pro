@@ -21,11 +21,31 @@ DEFINES += INSTALLERFOMOD_LIBRARY
 
 SOURCES += installerfomod.cpp \
     fomodinstallerdialog.cpp \
+    compiledconditions.cpp \
+    directoryindex.cpp \
+    encodingsniffer.cpp \
+    fomodcache.cpp \
+    fomoddocument.cpp \
+    flagstate.cpp \
+    fomodparser.cpp \
+    inactivemodindex.cpp \
+    installplan.cpp \
+    parsediagnostics.cpp \
     scalelabel.cpp \
     xmlreader.cpp
 
 HEADERS += installerfomod.h \
     fomodinstallerdialog.h \
+    compiledconditions.h \
+    directoryindex.h \
+    encodingsniffer.h \
+    fomodcache.h \
+    fomoddocument.h \
+    flagstate.h \
+    fomodparser.h \
+    inactivemodindex.h \
+    installplan.h \
+    parsediagnostics.h \
     scalelabel.h \
     xmlreader.h
 
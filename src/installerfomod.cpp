@@ -13,11 +13,27 @@
 #include <QStringList>
 #include <QImageReader>
 #include <QDebug>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
 
 
 using namespace MOBase;
 
 
+namespace {
+
+// the file name of a path, without the directory
+QString leafName(const QString &path)
+{
+  int pos = std::max(path.lastIndexOf('/'), path.lastIndexOf('\\'));
+  return path.mid(pos + 1);
+}
+
+}
+
+
 InstallerFomod::InstallerFomod()
   : m_MOInfo(nullptr)
 {
@@ -150,35 +166,78 @@ QStringList InstallerFomod::buildFomodTree(DirectoryTree &tree)
 }
 
 
-IPluginList::PluginStates InstallerFomod::fileState(const QString &fileName)
+std::vector<IPluginList::PluginStates> InstallerFomod::fileStates(const QStringList &fileNames)
 {
-  QString ext = QFileInfo(fileName).suffix().toLower();
-  if ((ext == "esp") || (ext == "esm")) {
-    IPluginList::PluginStates state = m_MOInfo->pluginList()->state(fileName);
-    if (state != IPluginList::STATE_MISSING) {
-      return state;
+  bool anyFile = allowAnyFile();
+  std::vector<IPluginList::PluginStates> result;
+  result.reserve(fileNames.size());
+  // files that may still turn up in a disabled mod
+  std::vector<int> missing;
+  // dependencies on arbitrary files, by directory
+  QHash<QString, std::vector<int>> directories;
+  for (int i = 0; i < fileNames.size(); ++i) {
+    const QString &fileName = fileNames.at(i);
+    IPluginList::PluginStates state = IPluginList::STATE_MISSING;
+    QString ext = QFileInfo(fileName).suffix().toLower();
+    if ((ext == "esp") || (ext == "esm")) {
+      state = m_MOInfo->pluginList()->state(fileName);
+    } else if (anyFile) {
+      // resolved below, together with the other files in the same directory
+      directories[QFileInfo(fileName).dir().path().toCaseFolded()].push_back(i);
+      result.push_back(IPluginList::STATE_MISSING);
+      continue;
+    } else {
+      qWarning() << "A dependency on non esp/esm " << fileName
+                 << " will always find it as missing";
+      result.push_back(IPluginList::STATE_MISSING);
+      continue;
     }
-  } else if (allowAnyFile()) {
-    QFileInfo info(fileName);
-    FileNameString name(info.fileName());
-    QStringList files = m_MOInfo->findFiles(
-        info.dir().path(), [&, name](const QString &f) -> bool {
-          return name == QFileInfo(f).fileName();
-        });
+    if (state == IPluginList::STATE_MISSING) {
+      missing.push_back(i);
+    }
+    result.push_back(state);
+  }
+
+  // List each directory once and look up all files requested from it in that listing
+  for (auto iter = directories.begin(); iter != directories.end(); ++iter) {
+    const std::vector<int> &requests = iter.value();
     // A note: The list of files produced is somewhat odd as it's the full path
     // to the originating mod (or mods). However, all we care about is if it's
     // there or not.
-    if (files.size() != 0) {
-      return IPluginList::STATE_ACTIVE;
+    QStringList files = m_MOInfo->findFiles(QFileInfo(fileNames.at(requests.front())).dir().path(),
+                                            [](const QString&) -> bool { return true; });
+    QSet<QString> names;
+    for (const QString &file : files) {
+      names.insert(leafName(file).toCaseFolded());
+    }
+    for (int i : requests) {
+      if (names.contains(leafName(fileNames.at(i)).toCaseFolded())) {
+        result[i] = IPluginList::STATE_ACTIVE;
+      } else {
+        missing.push_back(i);
+      }
     }
-  } else {
-    qWarning() << "A dependency on non esp/esm " << fileName
-               << " will always find it as missing";
-    return IPluginList::STATE_MISSING;
   }
 
   // If they are really desparate we look in the full mod list and try that
-  if (checkDisabledMods()) {
+  if (!missing.empty() && checkDisabledMods()) {
+    const InactiveModIndex &index = inactiveMods();
+    for (int i : missing) {
+      if (index.contains(fileNames.at(i))) {
+        result[i] = IPluginList::STATE_INACTIVE;
+      }
+    }
+  }
+  return result;
+}
+
+const InactiveModIndex &InstallerFomod::inactiveMods()
+{
+  if (m_InactiveMods.get() == nullptr) {
+    // the mod list is only accessed from this thread, the index then scans the
+    // mod directories in parallel
+    QStringList names;
+    QStringList paths;
     IModList *modList = m_MOInfo->modList();
     QStringList list = modList->allMods();
     for (QString mod : list) {
@@ -189,21 +248,20 @@ IPluginList::PluginStates InstallerFomod::fileState(const QString &fileName)
           || (state & IModList::STATE_VALID) == 0) {
         continue;
       }
-      MOBase::IModInterface *modInfo = m_MOInfo->getMod(mod);
-      // Go see if the file is in the mod
-      QDir modpath(modInfo->absolutePath());
-      QFile file(modpath.absoluteFilePath(fileName));
-      if (file.exists()) {
-        return IPluginList::STATE_INACTIVE;
-      }
+      names.append(mod);
+      paths.append(m_MOInfo->getMod(mod)->absolutePath());
     }
+    m_InactiveMods.reset(new InactiveModIndex(names, paths));
   }
-  return IPluginList::STATE_MISSING;
+  return *m_InactiveMods;
 }
 
 IPluginInstaller::EInstallResult InstallerFomod::install(GuessedValue<QString> &modName, DirectoryTree &tree,
                                                          QString &version, int &modID)
 {
+  // mods may have been enabled or disabled since the last install
+  m_InactiveMods.reset();
+
   QStringList installerFiles = buildFomodTree(tree);
   manager()->extractFiles(installerFiles, false);
 
@@ -211,7 +269,7 @@ IPluginInstaller::EInstallResult InstallerFomod::install(GuessedValue<QString> &
     const DirectoryTree *fomodTree = findFomodDirectory(&tree);
 
     QString fomodPath = fomodTree->getParent()->getFullPath();
-    FomodInstallerDialog dialog(modName, fomodPath, std::bind(&InstallerFomod::fileState, this, std::placeholders::_1));
+    FomodInstallerDialog dialog(modName, fomodPath, std::bind(&InstallerFomod::fileStates, this, std::placeholders::_1));
     dialog.initData(m_MOInfo);
     if (!dialog.getVersion().isEmpty()) {
       version = dialog.getVersion();
@@ -2,10 +2,15 @@
 #define INSTALLERFOMOD_H
 
 
+#include "inactivemodindex.h"
+
 #include <iplugininstallersimple.h>
 #include <iplugindiagnose.h>
 #include <ipluginlist.h>
 
+#include <memory>
+#include <vector>
+
 
 class InstallerFomod : public MOBase::IPluginInstallerSimple, public MOBase::IPluginDiagnose
 {
@@ -55,7 +60,18 @@ private:
   QStringList buildFomodTree(MOBase::DirectoryTree &tree);
 
   void appendImageFiles(QStringList &result, MOBase::DirectoryTree *tree);
-  MOBase::IPluginList::PluginStates fileState(const QString &fileName);
+
+  /**
+   * @brief determine the state of the files a fomod depends on
+   * @param fileNames names of the files, relative to the data directory
+   * @return the state of each file, in the same order
+   */
+  std::vector<MOBase::IPluginList::PluginStates> fileStates(const QStringList &fileNames);
+
+  /**
+   * @return index of the files in inactive mods, built on first use in each install
+   */
+  const InactiveModIndex &inactiveMods();
 
 private:
 
@@ -64,6 +80,7 @@ private:
 private:
 
   MOBase::IOrganizer *m_MOInfo;
+  std::unique_ptr<InactiveModIndex> m_InactiveMods;
 
   bool allowAnyFile() const;
   bool checkDisabledMods() const;
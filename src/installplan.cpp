@@ -0,0 +1,313 @@
+#include "installplan.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace {
+
+// "FMIP"
+const quint32 PLAN_MAGIC = 0x464d4950;
+
+// increase this whenever the serialized layout changes
+const quint32 PLAN_VERSION = 2;
+
+struct PlanError : std::runtime_error {
+  PlanError(const char *message)
+    : std::runtime_error(message) {}
+};
+
+
+void checkStatus(const QDataStream &stream)
+{
+  if (stream.status() != QDataStream::Ok) {
+    throw PlanError("truncated data");
+  }
+}
+
+quint32 readCount(QDataStream &stream)
+{
+  quint32 result;
+  stream >> result;
+  checkStatus(stream);
+  // every element takes up at least one byte
+  if (result > static_cast<quint64>(stream.device()->bytesAvailable())) {
+    throw PlanError("invalid count");
+  }
+  return result;
+}
+
+const QString &readString(QDataStream &stream, const std::vector<QString> &strings)
+{
+  qint32 index;
+  stream >> index;
+  checkStatus(stream);
+  if ((index < 0) || (index >= static_cast<qint32>(strings.size()))) {
+    throw PlanError("invalid string index");
+  }
+  return strings[index];
+}
+
+// unify separators and remove empty components
+QString normalizeDirectory(QString directory)
+{
+  directory.replace('\\', '/');
+  return directory.split('/', QString::SkipEmptyParts).join('/');
+}
+
+QString readJsonString(const QJsonObject &object, const char *key)
+{
+  QJsonValue value = object.value(key);
+  if (!value.isString()) {
+    throw PlanError("missing string");
+  }
+  return value.toString();
+}
+
+int readJsonInt(const QJsonObject &object, const char *key)
+{
+  QJsonValue value = object.value(key);
+  if (!value.isDouble()) {
+    throw PlanError("missing number");
+  }
+  return value.toInt();
+}
+
+QString readJsonName(const QJsonObject &object, const char *key)
+{
+  QString result = readJsonString(object, key);
+  if (result.contains('/') || result.contains('\\')) {
+    throw PlanError("invalid file name");
+  }
+  return result;
+}
+
+}
+
+
+InstallPlan::InstallPlan()
+{
+}
+
+void InstallPlan::add(const FomodDocument &document, const FileDescriptor &descriptor)
+{
+  add(document.string(descriptor.m_SourcePath.m_Directory), document.string(descriptor.m_SourcePath.m_Name),
+      document.string(descriptor.m_DestinationPath.m_Directory), document.string(descriptor.m_DestinationPath.m_Name),
+      descriptor.m_IsFolder, descriptor.m_Priority, descriptor.m_FileSystemItemSequence);
+}
+
+void InstallPlan::add(const QString &sourceDirectory, const QString &sourceName,
+                      const QString &destinationDirectory, const QString &destinationName,
+                      bool folder, int priority, int sequence)
+{
+  Operation operation;
+  operation.source = addPath(sourceDirectory, sourceName);
+  operation.destination = addPath(destinationDirectory, destinationName);
+  operation.folder = folder;
+  operation.priority = priority;
+  operation.sequence = sequence;
+
+  //Folders with the same destination are merged, whether any of their files collide
+  //is only known once the plan is applied to the archive. A file without a
+  //destination name keeps its source name
+  if (!folder) {
+    int name = operation.destination.m_NameKey != 0 ? operation.destination.m_NameKey
+                                                    : operation.source.m_NameKey;
+    QString key = string(operation.destination.m_DirectoryKey) + "/" + string(name);
+    int index = static_cast<int>(m_Operations.size());
+    auto iter = m_Destinations.find(key);
+    if (iter != m_Destinations.end()) {
+      Conflict conflict = { *iter, index };
+      m_Conflicts.push_back(conflict);
+      *iter = index;
+    } else {
+      m_Destinations.insert(key, index);
+    }
+  }
+
+  m_Operations.push_back(operation);
+}
+
+DescriptorPath InstallPlan::addPath(const QString &directory, const QString &name)
+{
+  DescriptorPath result;
+  result.m_Directory = m_Strings.add(directory);
+  result.m_DirectoryKey = m_Strings.add(directory.toCaseFolded());
+  result.m_Name = m_Strings.add(name);
+  result.m_NameKey = m_Strings.add(name.toCaseFolded());
+  return result;
+}
+
+QByteArray InstallPlan::toBinary() const
+{
+  //Only the strings as written are stored, the case folded keys are recalculated
+  StringPool strings;
+  std::vector<qint32> paths;
+  for (const Operation &operation : m_Operations) {
+    paths.push_back(strings.add(string(operation.source.m_Directory)));
+    paths.push_back(strings.add(string(operation.source.m_Name)));
+    paths.push_back(strings.add(string(operation.destination.m_Directory)));
+    paths.push_back(strings.add(string(operation.destination.m_Name)));
+  }
+
+  QByteArray result;
+  QDataStream stream(&result, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_5_0);
+  stream << PLAN_MAGIC << PLAN_VERSION;
+
+  stream << static_cast<quint32>(strings.size());
+  for (int i = 0; i < strings.size(); ++i) {
+    stream << strings.at(i);
+  }
+
+  stream << static_cast<quint32>(m_Operations.size());
+  for (size_t i = 0; i < m_Operations.size(); ++i) {
+    const Operation &operation = m_Operations[i];
+    for (size_t j = i * 4; j < i * 4 + 4; ++j) {
+      stream << paths[j];
+    }
+    stream << operation.folder << static_cast<qint32>(operation.priority)
+           << static_cast<qint32>(operation.sequence);
+  }
+
+  stream << static_cast<quint32>(m_Conflicts.size());
+  for (const Conflict &conflict : m_Conflicts) {
+    stream << static_cast<qint32>(conflict.overridden) << static_cast<qint32>(conflict.winner);
+  }
+  return result;
+}
+
+std::unique_ptr<InstallPlan> InstallPlan::fromBinary(const QByteArray &data)
+{
+  QDataStream stream(data);
+  stream.setVersion(QDataStream::Qt_5_0);
+  try {
+    quint32 magic;
+    quint32 version;
+    stream >> magic >> version;
+    checkStatus(stream);
+    if ((magic != PLAN_MAGIC) || (version != PLAN_VERSION)) {
+      throw PlanError("wrong format version");
+    }
+
+    std::vector<QString> strings(readCount(stream));
+    for (QString &string : strings) {
+      stream >> string;
+      checkStatus(stream);
+    }
+
+    std::unique_ptr<InstallPlan> result(new InstallPlan);
+    quint32 count = readCount(stream);
+    for (quint32 i = 0; i < count; ++i) {
+      const QString &sourceDirectory = readString(stream, strings);
+      const QString &sourceName = readString(stream, strings);
+      const QString &destinationDirectory = readString(stream, strings);
+      const QString &destinationName = readString(stream, strings);
+      bool folder;
+      qint32 priority;
+      qint32 sequence;
+      stream >> folder >> priority >> sequence;
+      checkStatus(stream);
+      result->add(sourceDirectory, sourceName, destinationDirectory, destinationName,
+                  folder, priority, sequence);
+    }
+
+    //The conflicts follow from the operations, the stored ones have to match
+    std::vector<Conflict> conflicts(readCount(stream));
+    for (Conflict &conflict : conflicts) {
+      qint32 overridden;
+      qint32 winner;
+      stream >> overridden >> winner;
+      checkStatus(stream);
+      conflict.overridden = overridden;
+      conflict.winner = winner;
+    }
+    if ((conflicts.size() != result->m_Conflicts.size())
+        || !std::equal(conflicts.begin(), conflicts.end(), result->m_Conflicts.begin(),
+                       [] (const Conflict &LHS, const Conflict &RHS) {
+                         return (LHS.overridden == RHS.overridden) && (LHS.winner == RHS.winner);
+                       })) {
+      throw PlanError("conflicts don't match operations");
+    }
+
+    if (!stream.atEnd()) {
+      throw PlanError("trailing data");
+    }
+    return result;
+  } catch (const PlanError &e) {
+    qDebug("invalid install plan: %s", e.what());
+    return nullptr;
+  }
+}
+
+QJsonDocument InstallPlan::toJson() const
+{
+  QJsonArray operations;
+  for (const Operation &operation : m_Operations) {
+    QJsonObject object;
+    object.insert("sourceDirectory", string(operation.source.m_Directory));
+    object.insert("sourceName", string(operation.source.m_Name));
+    object.insert("destinationDirectory", string(operation.destination.m_Directory));
+    object.insert("destinationName", string(operation.destination.m_Name));
+    object.insert("folder", operation.folder);
+    object.insert("priority", operation.priority);
+    object.insert("sequence", operation.sequence);
+    operations.append(object);
+  }
+
+  QJsonArray conflicts;
+  for (const Conflict &conflict : m_Conflicts) {
+    QJsonObject object;
+    object.insert("overridden", conflict.overridden);
+    object.insert("winner", conflict.winner);
+    conflicts.append(object);
+  }
+
+  QJsonObject root;
+  root.insert("version", static_cast<int>(PLAN_VERSION));
+  root.insert("operations", operations);
+  root.insert("conflicts", conflicts);
+  return QJsonDocument(root);
+}
+
+std::unique_ptr<InstallPlan> InstallPlan::fromJson(const QJsonDocument &document)
+{
+  try {
+    QJsonObject root = document.object();
+    if (readJsonInt(root, "version") != static_cast<int>(PLAN_VERSION)) {
+      throw PlanError("wrong format version");
+    }
+    if (!root.value("operations").isArray()) {
+      throw PlanError("missing operations");
+    }
+
+    //Conflicts are determined from the operations, they are only written for
+    //the benefit of readers
+    std::unique_ptr<InstallPlan> result(new InstallPlan);
+    for (const QJsonValue &value : root.value("operations").toArray()) {
+      if (!value.isObject()) {
+        throw PlanError("invalid operation");
+      }
+      QJsonObject object = value.toObject();
+      if (!object.value("folder").isBool()) {
+        throw PlanError("missing folder flag");
+      }
+      result->add(normalizeDirectory(readJsonString(object, "sourceDirectory")),
+                  readJsonName(object, "sourceName"),
+                  normalizeDirectory(readJsonString(object, "destinationDirectory")),
+                  readJsonName(object, "destinationName"),
+                  object.value("folder").toBool(),
+                  readJsonInt(object, "priority"), readJsonInt(object, "sequence"));
+    }
+    return result;
+  } catch (const PlanError &e) {
+    qDebug("invalid install plan: %s", e.what());
+    return nullptr;
+  }
+}
@@ -0,0 +1,109 @@
+#ifndef INSTALLPLAN_H
+#define INSTALLPLAN_H
+
+#include "fomoddocument.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonDocument>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+/**
+ * @brief the files to install for a fomod selection, independent of the document and the
+ *        archive it was made for.
+ *
+ * Operations are stored in the order they are applied: ascending priority, then in the order
+ * the files appear in the ModuleConfig.xml, so a later operation overwrites the files of an
+ * earlier one. File operations whose destinations are the same path are listed in a conflict
+ * table along with the one that prevails. Paths are split and normalized like those of file
+ * descriptors and stored in a string pool of the plan itself.
+ *
+ * A plan can be written in a compact binary form for caching or as json to be inspected and
+ * compared between selections.
+ */
+class InstallPlan
+{
+public:
+
+  struct Operation {
+    DescriptorPath source;
+    DescriptorPath destination;
+    bool folder;
+    int priority;
+    int sequence;
+  };
+
+  struct Conflict {
+    //Index of the operation whose destination is overwritten
+    int overridden;
+    //Index of the operation that is installed in its place
+    int winner;
+  };
+
+public:
+
+  InstallPlan();
+
+  /**
+   * @brief add an operation. Operations have to be added in the order they are to be applied
+   * @param document the document the paths of the descriptor refer to
+   */
+  void add(const FomodDocument &document, const FileDescriptor &descriptor);
+
+  const std::vector<Operation> &operations() const { return m_Operations; }
+
+  /**
+   * @return a string from the string pool of the plan
+   */
+  const QString &string(int index) const { return m_Strings.at(index); }
+
+  /**
+   * @return the file operations with the same destination, determined from the paths alone.
+   *         Folders are never listed, the files contained in them can only be compared
+   *         when the plan is applied
+   */
+  const std::vector<Conflict> &conflicts() const { return m_Conflicts; }
+
+  /**
+   * @return the plan in binary form
+   */
+  QByteArray toBinary() const;
+
+  /**
+   * @return the plan in the binary form or a null pointer if the data is invalid
+   */
+  static std::unique_ptr<InstallPlan> fromBinary(const QByteArray &data);
+
+  /**
+   * @return the plan as json
+   */
+  QJsonDocument toJson() const;
+
+  /**
+   * @return the plan read from json or a null pointer if the document is invalid
+   */
+  static std::unique_ptr<InstallPlan> fromJson(const QJsonDocument &document);
+
+private:
+
+  //All paths are given in normalized form
+  void add(const QString &sourceDirectory, const QString &sourceName,
+           const QString &destinationDirectory, const QString &destinationName,
+           bool folder, int priority, int sequence);
+
+  DescriptorPath addPath(const QString &directory, const QString &name);
+
+private:
+
+  StringPool m_Strings;
+  std::vector<Operation> m_Operations;
+  std::vector<Conflict> m_Conflicts;
+  //Index of the last file operation for each destination, to determine conflicts
+  QHash<QString, int> m_Destinations;
+
+};
+
+#endif // INSTALLPLAN_H
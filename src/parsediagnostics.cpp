@@ -0,0 +1,109 @@
+#include "parsediagnostics.h"
+
+
+namespace {
+
+// distinct entries kept. Everything beyond is only counted
+const size_t MAX_ENTRIES = 100;
+
+// indexed by QXmlStreamReader::TokenType
+const char *const TOKEN_NAMES[] = {
+  "NoToken",
+  "Invalid",
+  "StartDocument",
+  "EndDocument",
+  "StartElement",
+  "EndElement",
+  "Characters",
+  "Comment",
+  "DTD",
+  "EntityReference",
+  "ProcessingInstruction"
+};
+
+}
+
+
+ParseDiagnostics::ParseDiagnostics()
+  : m_Total(0), m_Dropped(0)
+{
+}
+
+void ParseDiagnostics::report(Code code, const QStringRef &element, qint64 line)
+{
+  QString name = element.toString();
+  auto iter = m_ElementIndices.constFind(name);
+  if (iter != m_ElementIndices.constEnd()) {
+    add(code, *iter, line);
+  } else if (m_Entries.size() < MAX_ENTRIES) {
+    int index = m_ElementNames.size();
+    m_ElementNames.append(name);
+    m_ElementIndices.insert(name, index);
+    add(code, index, line);
+  } else {
+    //No entry can refer to a name not seen before
+    ++m_Total;
+    ++m_Dropped;
+  }
+}
+
+void ParseDiagnostics::reportToken(int tokenType, qint64 line)
+{
+  add(DIAG_UNEXPECTED_TOKEN, tokenType, line);
+}
+
+void ParseDiagnostics::add(Code code, int detail, qint64 line)
+{
+  ++m_Total;
+  qint64 key = (static_cast<qint64>(code) << 32) | static_cast<quint32>(detail);
+  auto iter = m_EntryIndices.constFind(key);
+  if (iter != m_EntryIndices.constEnd()) {
+    ++m_Entries[*iter].count;
+  } else if (m_Entries.size() < MAX_ENTRIES) {
+    m_EntryIndices.insert(key, static_cast<int>(m_Entries.size()));
+    Entry entry = { code, detail, line, 1 };
+    m_Entries.push_back(entry);
+  } else {
+    ++m_Dropped;
+  }
+}
+
+QString ParseDiagnostics::elementName(const Entry &entry) const
+{
+  if (entry.code == DIAG_UNEXPECTED_TOKEN) {
+    if ((entry.detail >= 0)
+        && (entry.detail < static_cast<int>(sizeof(TOKEN_NAMES) / sizeof(TOKEN_NAMES[0])))) {
+      return TOKEN_NAMES[entry.detail];
+    } else {
+      return QString::number(entry.detail);
+    }
+  } else {
+    return m_ElementNames.at(entry.detail);
+  }
+}
+
+QString ParseDiagnostics::summary() const
+{
+  QStringList lines;
+  lines.append(QString("%1 problem(s) found while parsing").arg(m_Total));
+  for (const Entry &entry : m_Entries) {
+    QString message;
+    switch (entry.code) {
+      case DIAG_UNEXPECTED_ELEMENT: message = "unexpected element %1"; break;
+      case DIAG_MISMATCHED_END:     message = "unexpected end of element %1"; break;
+      case DIAG_UNEXPECTED_TOKEN:   message = "unexpected token %1"; break;
+      case DIAG_EMPTY_SOURCE:       message = "ignored %1 entry with empty source"; break;
+      case DIAG_INVALID_OPERATOR:   message = "invalid operator in %1, expected 'And' or 'Or'"; break;
+      case DIAG_EMPTY_CONDITION:    message = "empty condition in %1"; break;
+    }
+    message = message.arg(elementName(entry)) + QString(" at line %1").arg(entry.line);
+    if (entry.count > 1) {
+      message += QString(" (%1 times)").arg(entry.count);
+    }
+    lines.append("  " + message);
+  }
+  if (m_Dropped > 0) {
+    lines.append(QString("  %1 more").arg(m_Dropped));
+  }
+  return lines.join("\n");
+}
@@ -0,0 +1,96 @@
+#ifndef PARSEDIAGNOSTICS_H
+#define PARSEDIAGNOSTICS_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QStringRef>
+
+#include <vector>
+
+/**
+ * @brief collects the problems found while parsing a fomod.
+ *
+ * Broken or non-schema configs can produce thousands of warnings. Instead of logging each of
+ * them as they occur, they are recorded here. Repeats of the same problem on the same element
+ * are only counted and the number of distinct entries is capped, so recording is cheap.
+ * After parsing, all of it can be reported as one summary.
+ */
+class ParseDiagnostics
+{
+public:
+
+  enum Code {
+    DIAG_UNEXPECTED_ELEMENT,  // element not valid at this position
+    DIAG_MISMATCHED_END,      // end element that doesn't close the current element
+    DIAG_UNEXPECTED_TOKEN,    // token other than an element where an element was expected
+    DIAG_EMPTY_SOURCE,        // file or folder without a source, ignored
+    DIAG_INVALID_OPERATOR,    // dependency operator other than "And" or "Or"
+    DIAG_EMPTY_CONDITION      // dependency list without any conditions
+  };
+
+  struct Entry {
+    Code code;
+    // index into the element names for element related codes, the token type for DIAG_UNEXPECTED_TOKEN
+    int detail;
+    // line of the first occurrence
+    qint64 line;
+    // total number of occurrences
+    int count;
+  };
+
+public:
+
+  ParseDiagnostics();
+
+  /**
+   * @brief record a problem concerning an element
+   */
+  void report(Code code, const QStringRef &element, qint64 line);
+
+  /**
+   * @brief record an unexpected token
+   * @param tokenType the QXmlStreamReader::TokenType of the token
+   */
+  void reportToken(int tokenType, qint64 line);
+
+  bool empty() const { return m_Total == 0; }
+
+  /**
+   * @return number of problems recorded, including repeats
+   */
+  int count() const { return m_Total; }
+
+  /**
+   * @return the distinct problems in the order they were first encountered
+   */
+  const std::vector<Entry> &entries() const { return m_Entries; }
+
+  /**
+   * @return name of the element an entry refers to
+   */
+  QString elementName(const Entry &entry) const;
+
+  /**
+   * @return a human readable description of all recorded problems
+   */
+  QString summary() const;
+
+private:
+
+  void add(Code code, int detail, qint64 line);
+
+private:
+
+  std::vector<Entry> m_Entries;
+  //Index into m_Entries by code and detail
+  QHash<qint64, int> m_EntryIndices;
+  //Names are only kept while there is room for entries referring to them
+  QStringList m_ElementNames;
+  QHash<QString, int> m_ElementIndices;
+  int m_Total;
+  int m_Dropped;
+
+};
+
+#endif // PARSEDIAGNOSTICS_H
@@ -1,17 +1,79 @@
 #include "xmlreader.h"
 
 #include "utility.h"
-#include <QDebug>
+
+#include <algorithm>
 
 using MOBase::MyException;
 
-bool XmlReader::getNextElement(QString const &start)
+namespace {
+
+// indexed by XmlReader::Tag, has to be kept in ascii order
+char const *const TAG_NAMES[XmlReader::TAG_COUNT] = {
+  "",
+  "conditionFlags",
+  "conditionalFileInstalls",
+  "config",
+  "defaultType",
+  "dependencies",
+  "dependencyType",
+  "description",
+  "file",
+  "fileDependency",
+  "files",
+  "flag",
+  "flagDependency",
+  "folder",
+  "fommDependency",
+  "foseDependency",
+  "gameDependency",
+  "group",
+  "image",
+  "installStep",
+  "installSteps",
+  "moduleDependencies",
+  "moduleImage",
+  "moduleName",
+  "optionalFileGroups",
+  "pattern",
+  "patterns",
+  "plugin",
+  "plugins",
+  "requiredInstallFiles",
+  "type",
+  "typeDescriptor",
+  "visible"
+};
+
+}
+
+XmlReader::Tag XmlReader::tagForName(QStringRef const &name)
+{
+  char const *const *begin = TAG_NAMES + 1;
+  char const *const *end = TAG_NAMES + TAG_COUNT;
+  char const *const *iter = std::lower_bound(begin, end, name,
+                                             [] (char const *tagName, QStringRef const &name) {
+    return name.compare(QLatin1String(tagName)) > 0;
+  });
+  if ((iter != end) && (name == QLatin1String(*iter))) {
+    return static_cast<Tag>(iter - TAG_NAMES);
+  } else {
+    return TAG_UNKNOWN;
+  }
+}
+
+char const *XmlReader::tagName(Tag tag)
+{
+  return TAG_NAMES[tag];
+}
+
+bool XmlReader::getNextElement(Tag start)
 {
   while (!atEnd()) {
     switch (readNext()) {
       case EndElement:
-        if (name() != start) {
-          qWarning() << "Got end of " << name() << ", expected " << start << " at " << lineNumber();
+        if (m_Token != start) {
+          warn(ParseDiagnostics::DIAG_MISMATCHED_END);
           continue;
         }
         return false;
@@ -24,7 +86,7 @@ bool XmlReader::getNextElement(QString const &start)
         return false;
 
       default:
-        qWarning() << "Unexpected token type " << tokenString() << " at " << lineNumber();
+        m_Diagnostics.reportToken(tokenType(), lineNumber());
     }
   }
   return false;
@@ -32,21 +94,19 @@ bool XmlReader::getNextElement(QString const &start)
 
 void XmlReader::unexpected()
 {
-  qWarning() << "Unexpected element " << name() << " near line " << lineNumber();
-  //Eat the contents
-  QString s = readElementText(IncludeChildElements);
-  //Print them out if in debugging mode
-  qDebug() << " contains " << s;
+  warn(ParseDiagnostics::DIAG_UNEXPECTED_ELEMENT);
+  skipCurrentElement();
+  updateToken();
 }
 
 void XmlReader::finishedElement()
 {
-  QString const self = name().toString();
+  Tag const self = m_Token;
   while (!atEnd()) {
     switch (readNext()) {
       case EndElement:
-        if (name() != self) {
-          qWarning() << "Got end element for " << name() << ", expected " << self << " at " << lineNumber();
+        if (m_Token != self) {
+          warn(ParseDiagnostics::DIAG_MISMATCHED_END);
           continue;
         }
         return;
@@ -60,7 +120,7 @@ void XmlReader::finishedElement()
         break;
 
       default:
-        qWarning() << "Unexpected token type " << tokenString() << " at " << lineNumber();
+        m_Diagnostics.reportToken(tokenType(), lineNumber());
     }
   }
 }
@@ -68,14 +128,21 @@ void XmlReader::finishedElement()
 QString XmlReader::getText()
 {
   //This reads the text in an element, leaving you at the next element.
+  //Usually that is a single chunk, only if it's interrupted by comments do the
+  //pieces need to be concatenated.
   QString result;
   while (QXmlStreamReader::readNext() == Comment || tokenType() == Characters) {
     if (tokenType() == Characters) {
-      result += text();
+      if (result.isNull()) {
+        result = text().toString();
+      } else {
+        result.append(text());
+      }
     }
   }
+  updateToken();
   if (tokenType() != EndElement) {
-      qWarning() << "Unexpected token type " << tokenString() << " at " << lineNumber();
+      m_Diagnostics.reportToken(tokenType(), lineNumber());
   }
   return result;
 }
@@ -1,16 +1,62 @@
 #ifndef XMLREADER_H
 #define XMLREADER_H
 
+#include "parsediagnostics.h"
+
 #include <QXmlStreamReader>
 
 class XmlReader : public QXmlStreamReader {
  public:
+
+  /** Element names of the fomod schema. Sorted the same way as the name table
+   *  in xmlreader.cpp so the name of a tag can be looked up by index */
+  enum Tag {
+    TAG_UNKNOWN,
+    TAG_CONDITIONFLAGS,
+    TAG_CONDITIONALFILEINSTALLS,
+    TAG_CONFIG,
+    TAG_DEFAULTTYPE,
+    TAG_DEPENDENCIES,
+    TAG_DEPENDENCYTYPE,
+    TAG_DESCRIPTION,
+    TAG_FILE,
+    TAG_FILEDEPENDENCY,
+    TAG_FILES,
+    TAG_FLAG,
+    TAG_FLAGDEPENDENCY,
+    TAG_FOLDER,
+    TAG_FOMMDEPENDENCY,
+    TAG_FOSEDEPENDENCY,
+    TAG_GAMEDEPENDENCY,
+    TAG_GROUP,
+    TAG_IMAGE,
+    TAG_INSTALLSTEP,
+    TAG_INSTALLSTEPS,
+    TAG_MODULEDEPENDENCIES,
+    TAG_MODULEIMAGE,
+    TAG_MODULENAME,
+    TAG_OPTIONALFILEGROUPS,
+    TAG_PATTERN,
+    TAG_PATTERNS,
+    TAG_PLUGIN,
+    TAG_PLUGINS,
+    TAG_REQUIREDINSTALLFILES,
+    TAG_TYPE,
+    TAG_TYPEDESCRIPTOR,
+    TAG_VISIBLE,
+    TAG_COUNT
+  };
+
   XmlReader(QIODevice *device) :
-    QXmlStreamReader(device)
+    QXmlStreamReader(device), m_Token(TAG_UNKNOWN)
   { }
 
   XmlReader(QByteArray array) :
-    QXmlStreamReader(array)
+    QXmlStreamReader(array), m_Token(TAG_UNKNOWN)
+  { }
+
+  XmlReader(const QString &data) :
+    QXmlStreamReader(data), m_Token(TAG_UNKNOWN)
   { }
 
   /** Get the next token, ignoring comments and white space text */
@@ -19,25 +65,73 @@ class XmlReader : public QXmlStreamReader {
     while (QXmlStreamReader::readNext() == Comment || isWhitespace()) {
       continue;
     }
+    updateToken();
     return tokenType();
   }
 
+  /** The tag of the current start or end element. TAG_UNKNOWN for elements
+   *  not in the schema and for all other token types */
+  Tag token() const { return m_Token; }
+
+  /** The value of an attribute of the current element without copying it.
+   *  Empty if the attribute isn't set */
+  QStringRef attribute(char const *name) const
+  {
+    return attributes().value(QLatin1String(name));
+  }
+
+  bool hasAttribute(char const *name) const
+  {
+    return attributes().hasAttribute(QLatin1String(name));
+  }
+
+  /** Look up the tag for an element name */
+  static Tag tagForName(QStringRef const &name);
+
+  /** The element name of a tag */
+  static char const *tagName(Tag tag);
+
+  /** Problems found so far. Nothing is logged while parsing, these are
+   *  supposed to be reported once the document is read */
+  ParseDiagnostics &diagnostics() { return m_Diagnostics; }
+  ParseDiagnostics const &diagnostics() const { return m_Diagnostics; }
+
+  /** Record a problem with the current element */
+  void warn(ParseDiagnostics::Code code)
+  {
+    m_Diagnostics.report(code, name(), lineNumber());
+  }
+
   /** get the next element.
    *
-   * \param start - the name of the current start element
+   * \param start - the tag of the current start element
    *
    * \returns false if no more elements
    */
-  bool getNextElement(QString const &start);
+  bool getNextElement(Tag start);
 
   /* Get the text associated with this token. */
   QString getText();
 
-  /** Print a message if we get an unexpected tag */
+  /** Record an unexpected tag and skip over it */
   void unexpected();
 
   /** Read till the end of an element. Used for leaf nodes */
   void finishedElement();
+
+ private:
+
+  void updateToken()
+  {
+    TokenType type = tokenType();
+    m_Token = (type == StartElement || type == EndElement) ? tagForName(name())
+                                                           : TAG_UNKNOWN;
+  }
+
+ private:
+
+  Tag m_Token;
+  ParseDiagnostics m_Diagnostics;
 };
 
 